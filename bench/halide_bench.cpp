@@ -0,0 +1,292 @@
+#include "halide_bench.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace HalideBench {
+
+namespace {
+
+int env_int(const char *name, int fallback) {
+    const char *value = getenv(name);
+    return (value && *value) ? atoi(value) : fallback;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Sorted samples -> value at 0-based rank, clamped to the ends.
+double at_rank(const std::vector<double> &sorted, int rank) {
+    rank = std::max(0, std::min((int)sorted.size() - 1, rank));
+    return sorted[rank];
+}
+
+std::string json_escape(const std::string &s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+volatile unsigned flush_sink;
+
+size_t flush_size() {
+    size_t size = 64 * 1024 * 1024;
+#if defined(__linux__) && defined(_SC_LEVEL3_CACHE_SIZE)
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (llc > 0) {
+        size = std::max(size, 2 * (size_t)llc);
+    }
+#endif
+    return size;
+}
+
+}  // namespace
+
+std::string Stats::summary() const {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "median %.3f ms (95%% CI %.3f-%.3f), min %.3f, p95 %.3f",
+             median * 1e3, median_low * 1e3, median_high * 1e3, min * 1e3, p95 * 1e3);
+    std::string s = buf;
+    if (counters.valid) {
+        const double scale = pixels > 0 ? 1 / pixels : 1;
+        snprintf(buf, sizeof(buf), ", IPC %.2f", counters.ipc());
+        s += buf;
+        const char *separator = pixels > 0 ? ", per pixel: " : ", per call: ";
+        auto add = [&](double value, const char *what) {
+            if (value >= 0) {
+                snprintf(buf, sizeof(buf), "%s%.4g %s", separator, value * scale, what);
+                s += buf;
+                separator = ", ";
+            }
+        };
+        add(counters.llc_misses, "LLC misses");
+        add(counters.l1d_misses, "L1D misses");
+        add(counters.dtlb_misses, "dTLB misses");
+        add(counters.bytes, counters.bytes_from_dram ? "DRAM bytes" : "bytes");
+    }
+    return s;
+}
+
+Options with_environment(Options opts) {
+    opts.samples = std::max(1, env_int("HL_BENCH_SAMPLES", opts.samples));
+    opts.warmup = std::max(0, env_int("HL_BENCH_WARMUP", opts.warmup));
+    opts.cold_cache = env_int("HL_BENCH_COLD", opts.cold_cache) != 0;
+    opts.counters = env_int("HL_BENCH_COUNTERS", opts.counters) != 0;
+    if (const char *cpus = getenv("HL_BENCH_CPUS")) {
+        opts.cpus = cpus;
+    }
+    return opts;
+}
+
+Stats measure(const std::function<void()> &f, const Options &opts) {
+    // Pin once per process, before the warmup starts any worker threads.
+    static std::string pinned;
+    if (!opts.cpus.empty() && opts.cpus != pinned) {
+        if (set_affinity(opts.cpus)) {
+            pinned = opts.cpus;
+        } else {
+            fprintf(stderr, "HalideBench: could not pin to CPUs %s\n", opts.cpus.c_str());
+        }
+    }
+
+    for (int i = 0; i < opts.warmup; i++) {
+        f();
+    }
+
+    // After the warmup, so Halide's worker threads exist to be counted
+    std::unique_ptr<PerfCounters> counters;
+    if (opts.counters) {
+        counters.reset(new PerfCounters);
+        static bool warned = false;
+        if (!counters->error().empty() && !warned) {
+            fprintf(stderr, "HalideBench: no hardware counters, %s\n", counters->error().c_str());
+            warned = true;
+        }
+    }
+
+    const int iterations = std::max(1, opts.iterations);
+    std::vector<double> times;
+    for (int i = 0; i < std::max(1, opts.samples); i++) {
+        if (opts.cold_cache) {
+            flush_caches();
+        }
+        if (counters) {
+            counters->start();
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < iterations; j++) {
+            f();
+        }
+        times.push_back(seconds_since(start) / iterations);
+        if (counters) {
+            counters->stop();
+        }
+    }
+    std::sort(times.begin(), times.end());
+
+    Stats s;
+    if (counters) {
+        s.counters = counters->read((double)times.size() * iterations);
+    }
+    s.pixels = opts.pixels;
+    const int n = (int)times.size();
+    s.samples = n;
+    s.iterations = iterations;
+    s.min = times.front();
+    s.max = times.back();
+    s.median = (n % 2) ? times[n / 2] : 0.5 * (times[n / 2 - 1] + times[n / 2]);
+    for (double t : times) {
+        s.mean += t / n;
+    }
+    s.p95 = at_rank(times, (int)std::ceil(0.95 * n) - 1);
+
+    // The ranks n/2 -+ 1.96 sqrt(n) / 2 bracket the median with 95%
+    // probability, whatever the distribution of the samples.
+    double half_width = 0.98 * std::sqrt((double)n);
+    s.median_low = at_rank(times, (int)std::floor(n / 2.0 - half_width));
+    s.median_high = at_rank(times, (int)std::ceil(n / 2.0 + half_width) - 1);
+    return s;
+}
+
+Stats benchmark(const std::string &name, int samples, int iterations, const std::function<void()> &f) {
+    Options opts;
+    opts.samples = samples;
+    opts.iterations = iterations;
+    return benchmark(name, opts, f);
+}
+
+Stats benchmark(const std::string &name, const Options &opts, const std::function<void()> &f) {
+    Options actual = with_environment(opts);
+    Stats stats = measure(f, actual);
+    record(name, actual, stats);
+    return stats;
+}
+
+void record(const std::string &name, const Options &opts, const Stats &stats) {
+    const char *path = getenv("HL_BENCH_JSON");
+    if (!path || !*path) {
+        return;
+    }
+
+    // One line per record, so several binaries can append to one file.
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    FILE *f = fopen(path, "a");
+    if (!f) {
+        fprintf(stderr, "HalideBench: could not open %s\n", path);
+        return;
+    }
+    fprintf(f,
+            "{\"name\": \"%s\", \"samples\": %d, \"iterations\": %d, \"warmup\": %d, "
+            "\"cold_cache\": %s, \"cpus\": \"%s\", "
+            "\"min\": %.9g, \"median\": %.9g, \"median_low\": %.9g, \"median_high\": %.9g, "
+            "\"mean\": %.9g, \"p95\": %.9g, \"max\": %.9g",
+            json_escape(name).c_str(), stats.samples, stats.iterations, opts.warmup,
+            opts.cold_cache ? "true" : "false", json_escape(opts.cpus).c_str(),
+            stats.min, stats.median, stats.median_low, stats.median_high,
+            stats.mean, stats.p95, stats.max);
+    if (stats.pixels > 0) {
+        fprintf(f, ", \"pixels\": %.17g", stats.pixels);
+    }
+    // Counts per call; missing events are left out.
+    const Counters &c = stats.counters;
+    if (c.valid) {
+        const std::pair<const char *, double> fields[] = {
+            {"cycles", c.cycles},
+            {"instructions", c.instructions},
+            {"llc_misses", c.llc_misses},
+            {"l1d_misses", c.l1d_misses},
+            {"dtlb_misses", c.dtlb_misses},
+            {c.bytes_from_dram ? "dram_bytes" : "llc_miss_bytes", c.bytes}};
+        for (const auto &field : fields) {
+            if (field.second >= 0) {
+                fprintf(f, ", \"%s\": %.9g", field.first, field.second);
+            }
+        }
+    }
+    fprintf(f, "}\n");
+    fclose(f);
+}
+
+void flush_caches() {
+    static std::vector<unsigned char> buffer(flush_size(), 1);
+    unsigned sum = 0;
+    for (size_t i = 0; i < buffer.size(); i += 64) {
+        sum += buffer[i];
+    }
+    flush_sink = sum;
+}
+
+bool set_affinity(const std::string &cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    size_t pos = 0;
+    while (pos < cpus.size()) {
+        size_t end = cpus.find(',', pos);
+        std::string range = cpus.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        int first = 0, last = 0;
+        int n = sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (n < 1 || first < 0) {
+            return false;
+        }
+        if (n == 1) {
+            last = first;
+        }
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &set);
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+        pos = end + 1;
+    }
+    if (CPU_COUNT(&set) == 0) {
+        return false;
+    }
+
+    // sched_setaffinity applies to one thread, so walk all of them, in
+    // case Halide's thread pool is already running.
+    bool ok = sched_setaffinity(0, sizeof(set), &set) == 0;
+    if (DIR *dir = opendir("/proc/self/task")) {
+        while (dirent *entry = readdir(dir)) {
+            int tid = atoi(entry->d_name);
+            if (tid > 0) {
+                ok = (sched_setaffinity(tid, sizeof(set), &set) == 0) && ok;
+            }
+        }
+        closedir(dir);
+    }
+    return ok;
+#else
+    return false;
+#endif
+}
+
+}  // namespace HalideBench
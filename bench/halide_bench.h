@@ -0,0 +1,99 @@
+#ifndef HALIDE_BENCH_H
+#define HALIDE_BENCH_H
+
+// The benchmark harness shared by the examples and tutorials. It runs
+// a few untimed warmup calls, then times a number of samples of one or
+// more calls each, and reports the median with a 95% confidence
+// interval, the minimum and the 95th percentile.
+//
+// Every binary that uses it reads the same environment variables, so
+// runs can be configured without touching each command line:
+//
+//   HL_BENCH_SAMPLES=n    number of timed samples
+//   HL_BENCH_WARMUP=n     number of untimed calls before them
+//   HL_BENCH_COLD=1       evict the caches before every sample, for
+//                         cold-cache numbers (use with one iteration
+//                         per sample to mean anything)
+//   HL_BENCH_CPUS=0-3,8   pin the whole process, including Halide's
+//                         worker threads, to these CPUs (Linux only)
+//   HL_BENCH_COUNTERS=1   also count hardware events over the timed
+//                         calls, see Counters (Linux only)
+//   HL_BENCH_JSON=path    append every measurement to path as one JSON
+//                         object per line
+
+#include <functional>
+#include <string>
+
+namespace HalideBench {
+
+struct Options {
+    int warmup = 1;
+    int samples = 10;
+    // Calls per sample; the sample's time is divided by this
+    int iterations = 1;
+    bool cold_cache = false;
+    // CPU list in the format of taskset -c, empty to leave as is
+    std::string cpus;
+    bool counters = false;
+    // Pixels each call produces, for the per-pixel counter figures
+    double pixels = 0;
+};
+
+// Hardware event counts per call, over every thread of the process.
+// Events the CPU or kernel doesn't offer are negative, and nothing is
+// valid if perf_event_open can't be used at all.
+struct Counters {
+    bool valid = false;
+    double cycles = -1, instructions = -1;
+    // Last-level cache, L1 data cache and data TLB read misses
+    double llc_misses = -1, l1d_misses = -1, dtlb_misses = -1;
+    // Memory traffic: what the memory controllers saw if they can be
+    // read (system-wide, so other processes count too), otherwise
+    // LLC misses times the line size.
+    double bytes = -1;
+    bool bytes_from_dram = false;
+
+    // Instructions per cycle, or -1
+    double ipc() const;
+};
+
+// Times are in seconds per call.
+struct Stats {
+    int samples = 0, iterations = 0;
+    double min = 0, median = 0, mean = 0, p95 = 0, max = 0;
+    // Distribution-free 95% confidence interval of the median
+    double median_low = 0, median_high = 0;
+    Counters counters;
+    double pixels = 0;
+
+    // "median 1.234 ms (95% CI 1.200-1.250), min 1.190, p95 1.300",
+    // then when counted "IPC 2.10, per pixel: 0.012 LLC misses, 0.31
+    // L1D misses, 0.77 bytes" (or per call, without a pixel count)
+    std::string summary() const;
+};
+
+// opts with any of the HL_BENCH_* variables above applied.
+Options with_environment(Options opts);
+
+// Time f under opts exactly as given.
+Stats measure(const std::function<void()> &f, const Options &opts);
+
+// Time f with the given number of samples and calls per sample (the
+// same arguments as Halide::Tools::benchmark), unless the environment
+// says otherwise, and record the result under name.
+Stats benchmark(const std::string &name, int samples, int iterations, const std::function<void()> &f);
+Stats benchmark(const std::string &name, const Options &opts, const std::function<void()> &f);
+
+// Append one measurement to the HL_BENCH_JSON file, if it's set.
+void record(const std::string &name, const Options &opts, const Stats &stats);
+
+// Read through a buffer larger than the last-level cache.
+void flush_caches();
+
+// Pin every thread of the process to cpus, e.g. "0-3,8". Threads
+// created later inherit it. Returns false if that isn't possible.
+bool set_affinity(const std::string &cpus);
+
+}  // namespace HalideBench
+
+#endif  // HALIDE_BENCH_H
@@ -0,0 +1,234 @@
+// Runs a benchmark binary and compares the measurements it records
+// through halide_bench.h against a stored baseline. This is the driver
+// behind the CTest tests labelled "performance" (see CMakeLists.txt).
+//
+//   perf_check --baseline file --output file [--tolerance 0.1]
+//              [--only substring]... [--update] -- command [args...]
+//
+// The command runs with HL_BENCH_JSON pointing at the output file. A
+// measurement regresses if its median is more than the tolerance
+// slower than the baseline median, and its whole confidence interval
+// lies above the baseline's. Without a baseline, or with --update or
+// HL_PERF_UPDATE=1 in the environment, the results become the new
+// baseline instead.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+struct Record {
+    std::string line;
+    double median = 0, median_low = 0, median_high = 0;
+};
+
+// Pulls one field out of a line written by HalideBench::record.
+bool find_number(const std::string &line, const char *key, double *value) {
+    std::string pattern = std::string("\"") + key + "\": ";
+    size_t pos = line.find(pattern);
+    if (pos == std::string::npos) {
+        return false;
+    }
+    *value = strtod(line.c_str() + pos + pattern.size(), nullptr);
+    return true;
+}
+
+bool find_name(const std::string &line, std::string *name) {
+    const std::string pattern = "\"name\": \"";
+    size_t pos = line.find(pattern);
+    if (pos == std::string::npos) {
+        return false;
+    }
+    pos += pattern.size();
+    std::string value;
+    for (; pos < line.size() && line[pos] != '"'; pos++) {
+        if (line[pos] == '\\' && pos + 1 < line.size()) {
+            pos++;
+        }
+        value += line[pos];
+    }
+    *name = value;
+    return true;
+}
+
+// Records by name, in file order.
+bool read_records(const std::string &path, std::vector<std::string> *names, std::map<std::string, Record> *records) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        Record r;
+        std::string name;
+        r.line = line;
+        if (!find_name(line, &name) ||
+            !find_number(line, "median", &r.median) ||
+            !find_number(line, "median_low", &r.median_low) ||
+            !find_number(line, "median_high", &r.median_high)) {
+            continue;
+        }
+        if (!records->count(name)) {
+            names->push_back(name);
+        }
+        (*records)[name] = r;
+    }
+    return true;
+}
+
+void make_parent_directories(const std::string &path) {
+    for (size_t pos = path.find_first_of("/\\", 1); pos != std::string::npos;
+         pos = path.find_first_of("/\\", pos + 1)) {
+        std::string dir = path.substr(0, pos);
+#ifdef _WIN32
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+    }
+}
+
+bool copy_file(const std::string &from, const std::string &to) {
+    make_parent_directories(to);
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary);
+    if (!in || !out) {
+        return false;
+    }
+    out << in.rdbuf();
+    return (bool)out;
+}
+
+std::string quote(const std::string &arg) {
+    std::string quoted = "\"";
+    for (char c : arg) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+void show_usage_and_exit() {
+    fprintf(stderr,
+            "Usage: perf_check --baseline file --output file [--tolerance 0.1] "
+            "[--only substring]... [--update] -- command [args...]\n");
+    exit(1);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string baseline, output;
+    double tolerance = 0.1;
+    std::vector<std::string> only;
+    bool update = false;
+    int command_start = argc;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--baseline" && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (arg == "--only" && i + 1 < argc) {
+            only.push_back(argv[++i]);
+        } else if (arg == "--update") {
+            update = true;
+        } else if (arg == "--") {
+            command_start = i + 1;
+            break;
+        } else {
+            show_usage_and_exit();
+        }
+    }
+    if (baseline.empty() || output.empty() || command_start >= argc) {
+        show_usage_and_exit();
+    }
+    const char *update_env = getenv("HL_PERF_UPDATE");
+    update = update || (update_env && atoi(update_env) != 0);
+
+    // Run the benchmark, recording into a fresh output file.
+    std::remove(output.c_str());
+#ifdef _WIN32
+    _putenv_s("HL_BENCH_JSON", output.c_str());
+#else
+    setenv("HL_BENCH_JSON", output.c_str(), 1);
+#endif
+    std::string command;
+    for (int i = command_start; i < argc; i++) {
+        command += (command.empty() ? "" : " ") + quote(argv[i]);
+    }
+    fflush(stdout);
+    int status = std::system(command.c_str());
+    if (status != 0) {
+        fprintf(stderr, "Benchmark failed with status %d: %s\n", status, command.c_str());
+        return 1;
+    }
+
+    std::vector<std::string> names;
+    std::map<std::string, Record> current;
+    if (!read_records(output, &names, &current) || names.empty()) {
+        fprintf(stderr, "The benchmark recorded no measurements in %s\n", output.c_str());
+        return 1;
+    }
+
+    std::vector<std::string> baseline_names;
+    std::map<std::string, Record> expected;
+    bool have_baseline = read_records(baseline, &baseline_names, &expected);
+    if (update || !have_baseline) {
+        if (!copy_file(output, baseline)) {
+            fprintf(stderr, "Could not write the baseline %s\n", baseline.c_str());
+            return 1;
+        }
+        // Nothing was compared, so report the test as skipped.
+        printf("[SKIP] %s baseline %s\n", have_baseline ? "Updated" : "Recorded new", baseline.c_str());
+        return 0;
+    }
+
+    int regressions = 0, compared = 0;
+    printf("%-56s  %12s  %12s  %8s\n", "measurement", "baseline ms", "current ms", "change");
+    for (const std::string &name : names) {
+        bool selected = only.empty();
+        for (const std::string &s : only) {
+            selected = selected || name.find(s) != std::string::npos;
+        }
+        auto it = expected.find(name);
+        if (!selected || it == expected.end()) {
+            continue;
+        }
+        const Record &now = current[name], &then = it->second;
+        double change = now.median / then.median - 1.0;
+        bool regressed = change > tolerance && now.median_low > then.median_high;
+        printf("%-56s  %12.4f  %12.4f  %+7.1f%%%s\n",
+               name.c_str(), then.median * 1e3, now.median * 1e3, change * 100,
+               regressed ? "  REGRESSION" : "");
+        regressions += regressed;
+        compared++;
+    }
+
+    if (compared == 0) {
+        printf("[SKIP] No measurement matches the baseline %s\n", baseline.c_str());
+        return 0;
+    }
+    if (regressions) {
+        printf("%d of %d measurements regressed by more than %.0f%%\n",
+               regressions, compared, tolerance * 100);
+        return 1;
+    }
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,325 @@
+#include "perf_counters.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#endif
+
+namespace HalideBench {
+
+namespace {
+
+// Bytes moved per LLC miss, and per memory controller CAS command
+const double cache_line_bytes = 64;
+
+}  // namespace
+
+double Counters::ipc() const {
+    return (cycles > 0 && instructions >= 0) ? instructions / cycles : -1;
+}
+
+#ifdef __linux__
+
+namespace {
+
+std::string read_line(const std::string &path) {
+    std::string line;
+    if (FILE *f = fopen(path.c_str(), "r")) {
+        char buf[256];
+        if (fgets(buf, sizeof(buf), f)) {
+            line = buf;
+            while (!line.empty() && (line.back() == '\n' || line.back() == ' ')) {
+                line.pop_back();
+            }
+        }
+        fclose(f);
+    }
+    return line;
+}
+
+std::vector<int> thread_ids() {
+    std::vector<int> tids;
+    if (DIR *dir = opendir("/proc/self/task")) {
+        while (dirent *entry = readdir(dir)) {
+            int tid = atoi(entry->d_name);
+            if (tid > 0) {
+                tids.push_back(tid);
+            }
+        }
+        closedir(dir);
+    }
+    return tids;
+}
+
+// Counts user-space events of one thread (pid, any cpu), or everything
+// on one cpu (pid -1) for the system-wide memory controller events,
+// which don't accept the exclude flags.
+int open_event(uint32_t type, uint64_t config, int pid, int cpu) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = pid >= 0;
+    attr.exclude_hv = pid >= 0;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, pid, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+// The event in every thread, or nothing if the first thread can't have it.
+std::vector<int> open_per_thread(uint32_t type, uint64_t config, const std::vector<int> &tids, int *error) {
+    std::vector<int> fds;
+    for (int tid : tids) {
+        int fd = open_event(type, config, tid, -1);
+        if (fd >= 0) {
+            fds.push_back(fd);
+        } else if (fds.empty()) {
+            // Threads can exit while we walk them; the first one is the
+            // main thread, so its failure means the event is unusable.
+            *error = errno;
+            return fds;
+        }
+    }
+    return fds;
+}
+
+uint64_t cache_miss_config(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// Parses a PMU event description like "event=0x04,umask=0x03" into a
+// config value, placing each term where the PMU's format/ directory
+// says, e.g. "config:8-15".
+bool pmu_event_config(const std::string &pmu, const std::string &event, uint64_t *config) {
+    std::string description = read_line(pmu + "/events/" + event);
+    if (description.empty()) {
+        return false;
+    }
+    *config = 0;
+    size_t pos = 0;
+    while (pos < description.size()) {
+        size_t end = description.find(',', pos);
+        std::string term = description.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        size_t eq = term.find('=');
+        std::string key = term.substr(0, eq);
+        uint64_t value = eq == std::string::npos ? 1 : strtoull(term.c_str() + eq + 1, nullptr, 0);
+        int low = 0;
+        if (sscanf(read_line(pmu + "/format/" + key).c_str(), "config:%d", &low) != 1) {
+            return false;
+        }
+        *config |= value << low;
+        if (end == std::string::npos) {
+            break;
+        }
+        pos = end + 1;
+    }
+    return true;
+}
+
+// The CPUs in a sysfs CPU list like "0,18" or "0-3,8".
+std::vector<int> cpu_list(const std::string &list) {
+    std::vector<int> cpus;
+    const char *p = list.c_str();
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            cpus.push_back((int)cpu);
+        }
+        p = *end == ',' ? end + 1 : end;
+        if (p == end && *p) {
+            break;
+        }
+    }
+    return cpus;
+}
+
+// CAS commands of every Intel memory controller, which need a
+// perf_event_paranoid of 0 or CAP_PERFMON. Empty if any can't be opened.
+std::vector<int> open_memory_controllers() {
+    const std::string root = "/sys/bus/event_source/devices/";
+    std::vector<int> fds;
+    bool ok = true;
+    if (DIR *dir = opendir(root.c_str())) {
+        while (dirent *entry = readdir(dir)) {
+            if (strncmp(entry->d_name, "uncore_imc", 10) != 0) {
+                continue;
+            }
+            std::string pmu = root + entry->d_name;
+            uint32_t type = (uint32_t)atoi(read_line(pmu + "/type").c_str());
+            // A controller of each socket is counted on one CPU of that
+            // socket, and the cpumask lists one per socket.
+            std::vector<int> cpus = cpu_list(read_line(pmu + "/cpumask"));
+            if (cpus.empty()) {
+                ok = false;
+            }
+            for (const char *event : {"cas_count_read", "cas_count_write"}) {
+                uint64_t config;
+                if (!pmu_event_config(pmu, event, &config)) {
+                    ok = false;
+                    continue;
+                }
+                for (int cpu : cpus) {
+                    int fd = open_event(type, config, -1, cpu);
+                    if (fd >= 0) {
+                        fds.push_back(fd);
+                    } else {
+                        ok = false;
+                    }
+                }
+            }
+        }
+        closedir(dir);
+    }
+    if (!ok) {
+        for (int fd : fds) {
+            close(fd);
+        }
+        fds.clear();
+    }
+    return fds;
+}
+
+double read_scaled(const std::vector<int> &fds) {
+    if (fds.empty()) {
+        return -1;
+    }
+    double total = 0;
+    for (int fd : fds) {
+        // value, time enabled, time running; the ratio corrects for the
+        // kernel multiplexing more events than there are counters
+        uint64_t values[3];
+        if (read(fd, values, sizeof(values)) == (ssize_t)sizeof(values) && values[2] > 0) {
+            total += (double)values[0] * ((double)values[1] / (double)values[2]);
+        }
+    }
+    return total;
+}
+
+}  // namespace
+
+PerfCounters::PerfCounters() {
+    std::vector<int> tids = thread_ids();
+    int error = 0;
+    fds_[Cycles] = open_per_thread(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, tids, &error);
+    if (!fds_[Cycles].empty()) {
+        fds_[Instructions] = open_per_thread(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, tids, &error);
+    }
+    if (fds_[Cycles].empty() || fds_[Instructions].empty()) {
+        error_ = std::string("perf_event_open: ") + strerror(error ? error : ENOENT);
+        std::string paranoid = read_line("/proc/sys/kernel/perf_event_paranoid");
+        if (error == EACCES && !paranoid.empty()) {
+            error_ += " (perf_event_paranoid is " + paranoid + ")";
+        }
+        for (std::vector<int> &fds : fds_) {
+            for (int fd : fds) {
+                close(fd);
+            }
+            fds.clear();
+        }
+        return;
+    }
+
+    // The rest are optional: virtual machines and some CPUs lack them.
+    int ignored;
+    fds_[LLCMisses] = open_per_thread(PERF_TYPE_HW_CACHE, cache_miss_config(PERF_COUNT_HW_CACHE_LL), tids, &ignored);
+    if (fds_[LLCMisses].empty()) {
+        fds_[LLCMisses] = open_per_thread(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, tids, &ignored);
+    }
+    fds_[L1DMisses] = open_per_thread(PERF_TYPE_HW_CACHE, cache_miss_config(PERF_COUNT_HW_CACHE_L1D), tids, &ignored);
+    fds_[DTLBMisses] = open_per_thread(PERF_TYPE_HW_CACHE, cache_miss_config(PERF_COUNT_HW_CACHE_DTLB), tids, &ignored);
+    fds_[DRAMAccesses] = open_memory_controllers();
+}
+
+PerfCounters::~PerfCounters() {
+    for (const std::vector<int> &fds : fds_) {
+        for (int fd : fds) {
+            close(fd);
+        }
+    }
+}
+
+void PerfCounters::start() {
+    for (const std::vector<int> &fds : fds_) {
+        for (int fd : fds) {
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::stop() {
+    for (const std::vector<int> &fds : fds_) {
+        for (int fd : fds) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+}
+
+Counters PerfCounters::read(double calls) const {
+    Counters c;
+    if (!error_.empty() || calls <= 0) {
+        return c;
+    }
+    auto per_call = [&](Event e) {
+        double total = read_scaled(fds_[e]);
+        return total < 0 ? total : total / calls;
+    };
+    c.valid = true;
+    c.cycles = per_call(Cycles);
+    c.instructions = per_call(Instructions);
+    c.llc_misses = per_call(LLCMisses);
+    c.l1d_misses = per_call(L1DMisses);
+    c.dtlb_misses = per_call(DTLBMisses);
+    double dram = per_call(DRAMAccesses);
+    if (dram >= 0) {
+        c.bytes = dram * cache_line_bytes;
+        c.bytes_from_dram = true;
+    } else if (c.llc_misses >= 0) {
+        c.bytes = c.llc_misses * cache_line_bytes;
+    }
+    return c;
+}
+
+#else
+
+PerfCounters::PerfCounters()
+    : error_("hardware counters need Linux") {
+}
+
+PerfCounters::~PerfCounters() {
+}
+
+void PerfCounters::start() {
+}
+
+void PerfCounters::stop() {
+}
+
+Counters PerfCounters::read(double) const {
+    return Counters();
+}
+
+#endif
+
+}  // namespace HalideBench
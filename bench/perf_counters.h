@@ -0,0 +1,54 @@
+#ifndef HALIDE_BENCH_PERF_COUNTERS_H
+#define HALIDE_BENCH_PERF_COUNTERS_H
+
+// Hardware event counts over the timed regions of a measurement, read
+// through perf_event_open. Used by measure() when counters are asked
+// for; only Linux has them, elsewhere error() says so.
+
+#include <string>
+#include <vector>
+
+#include "halide_bench.h"
+
+namespace HalideBench {
+
+class PerfCounters {
+public:
+    // Opens the counters in every thread the process has now. Threads
+    // started later aren't counted, so construct this after the warmup
+    // has started Halide's thread pool.
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // Empty if the counters work, otherwise the reason they don't
+    const std::string &error() const {
+        return error_;
+    }
+
+    // Count between start() and stop(); counts add up across regions.
+    void start();
+    void stop();
+
+    // Everything counted so far, divided by the number of calls
+    Counters read(double calls) const;
+
+private:
+    enum Event { Cycles,
+                 Instructions,
+                 LLCMisses,
+                 L1DMisses,
+                 DTLBMisses,
+                 DRAMAccesses,
+                 EventCount };
+    // One fd per thread, or per memory controller and socket; empty if
+    // the event isn't available.
+    std::vector<int> fds_[EventCount];
+    std::string error_;
+};
+
+}  // namespace HalideBench
+
+#endif  // HALIDE_BENCH_PERF_COUNTERS_H
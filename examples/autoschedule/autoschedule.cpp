@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "HalideBuffer.h"
+#include "halide_bench.h"
+
+#include "blur_manual.h"
+#include "harris_manual.h"
+#include "lesson_12_manual.h"
+#include "resize_manual.h"
+#ifdef WITH_MULLAPUDI2016
+#include "blur_mullapudi2016.h"
+#include "harris_mullapudi2016.h"
+#include "lesson_12_mullapudi2016.h"
+#include "resize_mullapudi2016.h"
+#endif
+#ifdef WITH_LI2018
+#include "blur_li2018.h"
+#include "harris_li2018.h"
+#include "lesson_12_li2018.h"
+#include "resize_li2018.h"
+#endif
+#ifdef WITH_ADAMS2019
+#include "blur_adams2019.h"
+#include "harris_adams2019.h"
+#include "lesson_12_adams2019.h"
+#include "resize_adams2019.h"
+#endif
+
+using Halide::Runtime::Buffer;
+
+// Every pipeline with its hand-written schedule and with each
+// auto-scheduler this Halide was built with, all given the host's
+// machine parameters (see CMakeLists.txt). Each auto schedule is
+// checked against the output of the manual one.
+
+#ifdef WITH_MULLAPUDI2016
+#define MULLAPUDI2016(APP) {"Mullapudi2016", &APP##_mullapudi2016},
+#else
+#define MULLAPUDI2016(APP)
+#endif
+#ifdef WITH_LI2018
+#define LI2018(APP) {"Li2018", &APP##_li2018},
+#else
+#define LI2018(APP)
+#endif
+#ifdef WITH_ADAMS2019
+#define ADAMS2019(APP) {"Adams2019", &APP##_adams2019},
+#else
+#define ADAMS2019(APP)
+#endif
+
+// The manual schedule first, then whichever auto schedules were built.
+#define SCHEDULES(APP) {{"manual", &APP##_manual}, MULLAPUDI2016(APP) LI2018(APP) ADAMS2019(APP)}
+
+const int samples = 10, iters = 10;
+
+template<typename Fn>
+struct Schedule {
+    const char *name;
+    Fn fn;
+};
+
+struct Result {
+    std::string app, schedule;
+    double time;
+    double max_diff;
+    bool ok;
+};
+
+std::vector<Result> results;
+
+template<typename T>
+double max_difference(Buffer<T> a, Buffer<T> b) {
+    double max_diff = 0;
+    a.for_each_element([&](const int *pos) {
+        max_diff = std::max(max_diff, std::abs((double)a(pos) - (double)b(pos)));
+    });
+    return max_diff;
+}
+
+// Time each schedule of one pipeline. run calls a variant and writes
+// the output that's compared; the first schedule is the reference.
+template<typename Fn, typename T>
+void compare_schedules(const char *app, const std::vector<Schedule<Fn>> &schedules,
+                       std::function<int(Fn, Buffer<T>)> run, Buffer<T> out, double tolerance) {
+    Buffer<T> reference;
+    for (const Schedule<Fn> &s : schedules) {
+        bool ok = true;
+        std::string name = std::string("autoschedule/") + app + "/" + s.name;
+        double time = HalideBench::benchmark(name, samples, iters, [&]() {
+            if (run(s.fn, out) != 0) {
+                ok = false;
+            }
+        }).median;
+        if (!reference.defined()) {
+            reference = out.copy();
+        }
+        double diff = max_difference(out, reference);
+        ok = ok && diff <= tolerance;
+        results.push_back({app, s.name, time, diff, ok});
+    }
+}
+
+template<typename T>
+void fill(Buffer<T> im, float range) {
+    im.for_each_value([&](T &v) {
+        v = (T)(rand() / (float)RAND_MAX * range);
+    });
+}
+
+int main(int argc, char **argv) {
+    printf("machine_params: %s\n", MACHINE_PARAMS);
+
+    {
+        typedef decltype(&blur_manual) Fn;
+        Buffer<uint16_t> input(4104, 2050), output(4096, 2048);
+        fill(input, 65535.0f);
+        compare_schedules<Fn, uint16_t>("blur", SCHEDULES(blur), [&](Fn fn, Buffer<uint16_t> out) { return fn(input, out); }, output, 0);
+    }
+
+    {
+        typedef decltype(&resize_manual) Fn;
+        Buffer<uint8_t> input(3840, 2160, 3), output(1920, 1080, 3);
+        fill(input, 255.0f);
+        // Every schedule is built for y first (pass_order_fixed=y, what
+        // resize_pass_order() picks for a 2x downsample), which the
+        // pass_order argument then only restates. The auto-scheduled
+        // pipelines may still round differently.
+        compare_schedules<Fn, uint8_t>("resize", SCHEDULES(resize), [&](Fn fn, Buffer<uint8_t> out) { return fn(input, 0.5f, 0.5f, 2, out); }, output, 1);
+    }
+
+    {
+        typedef decltype(&lesson_12_manual) Fn;
+        Buffer<uint8_t> input(3840, 2160, 3), output(3840, 2160, 3);
+        fill(input, 255.0f);
+        compare_schedules<Fn, uint8_t>("lesson_12", SCHEDULES(lesson_12), [&](Fn fn, Buffer<uint8_t> out) { return fn(input, out); }, output, 0);
+    }
+
+    {
+        typedef decltype(&harris_manual) Fn;
+        Buffer<float> input(1024, 1024, 3), output1(1024, 1024), output2(1024, 1024);
+        fill(input, 1.0f);
+        compare_schedules<Fn, float>("harris", SCHEDULES(harris), [&](Fn fn, Buffer<float> out) { return fn(input, 2.0f, out, output2); }, output1, 1e-4);
+    }
+
+    bool ok = true;
+    double manual_time = 0;
+    printf("\n%-10s  %-14s  %10s  %9s  %9s\n", "app", "schedule", "time (ms)", "speedup", "max diff");
+    for (const Result &r : results) {
+        if (r.schedule == "manual") {
+            manual_time = r.time;
+        }
+        printf("%-10s  %-14s  %10.3f  %8.2fx  %9g%s\n",
+               r.app.c_str(), r.schedule.c_str(), r.time * 1000, manual_time / r.time, r.max_diff,
+               r.ok ? "" : "  FAILED");
+        ok = ok && r.ok;
+    }
+
+    if (!ok) {
+        printf("Some schedules failed or gave different results\n");
+        return 1;
+    }
+    printf("Success!\n");
+    return 0;
+}
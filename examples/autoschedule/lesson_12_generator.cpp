@@ -0,0 +1,65 @@
+#include "Halide.h"
+
+using namespace Halide;
+
+namespace {
+
+// The CPU pipeline of tutorial lesson 12 (sharpen, then a tone curve
+// through a lookup table) as a generator, so it can be compiled ahead
+// of time with its hand-written schedule or with an auto-scheduler.
+class Lesson12 : public Halide::Generator<Lesson12> {
+public:
+    Input<Buffer<uint8_t>> input{"input", 3};
+    Output<Buffer<uint8_t>> curved{"curved", 3};
+
+    Var x{"x"}, y{"y"}, c{"c"}, i{"i"};
+    Func lut{"lut"}, padded{"padded"}, padded16{"padded16"}, sharpen{"sharpen"};
+
+    void generate() {
+        lut(i) = cast<uint8_t>(clamp(pow(i / 255.0f, 1.2f) * 255.0f, 0, 255));
+
+        padded(x, y, c) = input(clamp(x, 0, input.width() - 1),
+                                clamp(y, 0, input.height() - 1), c);
+
+        padded16(x, y, c) = cast<uint16_t>(padded(x, y, c));
+
+        sharpen(x, y, c) = (padded16(x, y, c) * 2 -
+                            (padded16(x - 1, y, c) +
+                             padded16(x, y - 1, c) +
+                             padded16(x + 1, y, c) +
+                             padded16(x, y + 1, c)) /
+                                4);
+
+        curved(x, y, c) = lut(sharpen(x, y, c));
+    }
+
+    void schedule() {
+        if (auto_schedule) {
+            input.set_estimates({{0, 3840}, {0, 2160}, {0, 3}});
+            curved.set_estimates({{0, 3840}, {0, 2160}, {0, 3}});
+            return;
+        }
+
+        // MyPipeline::schedule_for_cpu from the lesson.
+        lut.compute_root();
+
+        curved.reorder(c, x, y)
+            .bound(c, 0, 3)
+            .unroll(c);
+
+        Var yo, yi;
+        curved.split(y, yo, yi, 16)
+            .parallel(yo);
+
+        sharpen.compute_at(curved, yi);
+        sharpen.vectorize(x, 8);
+
+        padded.store_at(curved, yo)
+            .compute_at(curved, yi);
+        padded.vectorize(x, 16);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(Lesson12, lesson_12)
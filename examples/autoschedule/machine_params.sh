@@ -0,0 +1,31 @@
+#!/bin/sh
+# Prints machine_params for the auto-schedulers, as the CMake build
+# detects them: physical cores, the size in bytes of the largest data
+# cache of cpu0, and Halide's default balance of 40.
+
+CPU=/sys/devices/system/cpu
+
+CORES=$(cat $CPU/cpu[0-9]*/topology/thread_siblings_list 2>/dev/null | sort -u | wc -l)
+if [ "$CORES" -eq 0 ]; then
+    CORES=$(getconf _NPROCESSORS_ONLN)
+fi
+
+CACHE=16777216
+LEVEL=0
+for DIR in $CPU/cpu0/cache/index*; do
+    [ -f "$DIR/size" ] || continue
+    [ "$(cat "$DIR/type")" = Instruction ] && continue
+    L=$(cat "$DIR/level")
+    [ "$L" -gt "$LEVEL" ] || continue
+    SIZE=$(cat "$DIR/size")
+    case $SIZE in
+        *K) BYTES=$((${SIZE%K} * 1024)) ;;
+        *M) BYTES=$((${SIZE%M} * 1024 * 1024)) ;;
+        *G) BYTES=$((${SIZE%G} * 1024 * 1024 * 1024)) ;;
+        *) BYTES=$SIZE ;;
+    esac
+    LEVEL=$L
+    CACHE=$BYTES
+done
+
+echo "$CORES,$CACHE,40"
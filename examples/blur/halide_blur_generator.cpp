@@ -19,6 +19,28 @@ std::map<std::string, BlurGPUSchedule> blurGPUScheduleEnumMap() {
     };
 };
 
+// How the CPU schedule handles extents that aren't a multiple of the
+// split and vector sizes. Epilogue runs whole strips and vectors with no
+// tail code when the output is a multiple of them, and guards the
+// remainder with scalar code otherwise.
+enum class BlurTail {
+    Auto,
+    ShiftInwards,
+    GuardWithIf,
+    RoundUp,  // The caller pads the output to 128 x 32.
+    Epilogue,
+};
+
+std::map<std::string, BlurTail> blurTailEnumMap() {
+    return {
+        {"auto", BlurTail::Auto},
+        {"shift_inwards", BlurTail::ShiftInwards},
+        {"guard_with_if", BlurTail::GuardWithIf},
+        {"round_up", BlurTail::RoundUp},
+        {"epilogue", BlurTail::Epilogue},
+    };
+};
+
 class HalideBlur : public Halide::Generator<HalideBlur> {
 public:
     GeneratorParam<BlurGPUSchedule> schedule{
@@ -27,6 +49,10 @@ public:
         blurGPUScheduleEnumMap()};
     GeneratorParam<int> tile_x{"tile_x", 32};  // X tile.
     GeneratorParam<int> tile_y{"tile_y", 8};   // Y tile.
+    // Outputs at most this big in both dimensions take a serial,
+    // narrow-vector path on the CPU; 0 turns it off.
+    GeneratorParam<int> small_size{"small_size", 256};
+    GeneratorParam<BlurTail> tail{"tail", BlurTail::Auto, blurTailEnumMap()};
 
     Input<Buffer<uint16_t>> input{"input", 2};
     Output<Buffer<uint16_t>> blur_y{"blur_y", 2};
@@ -42,7 +68,12 @@ public:
         printf("\nHalide Target: %s\n", get_target().to_string().c_str());
     
         // How to schedule it
-        if (get_target().has_gpu_feature()) {
+        if (auto_schedule) {
+            // Leave it to the auto-scheduler (see ../autoschedule), at
+            // the size that harness runs.
+            input.set_estimates({{0, 4104}, {0, 2050}});
+            blur_y.set_estimates({{0, 4096}, {0, 2048}});
+        } else if (get_target().has_gpu_feature()) {
             // GPU schedule.
             printf("\n\n*********** GPU schedule ***************\n\n");
             switch (schedule) {
@@ -102,9 +133,39 @@ public:
             // CPU schedule.
             printf("\n\n*********** CPU schedule ***************\n\n");
         #if 1
-            blur_y.split(y, y, yi, 32).parallel(y).vectorize(x, 128);
+            // Small crops: with 128-wide vectors and a task per strip,
+            // the overhead outweighs the work, so run the strips in
+            // order with native vectors. The specialization copies the
+            // schedule as it is now, so it comes first.
+            auto schedule_cpu = [&](Halide::Stage s, TailStrategy strategy) {
+                if (small_size > 0) {
+                    Expr small = blur_y.dim(0).extent() <= small_size && blur_y.dim(1).extent() <= small_size;
+                    s.specialize(small)
+                        .split(y, y, yi, 32, strategy)
+                        .vectorize(x, natural_vector_size<uint16_t>(), strategy);
+                }
+                s.split(y, y, yi, 32, strategy).parallel(y).vectorize(x, 128, strategy);
+            };
+            if (tail == BlurTail::Epilogue) {
+                Expr aligned = blur_y.dim(0).extent() % 128 == 0 && blur_y.dim(1).extent() % 32 == 0;
+                schedule_cpu(blur_y.specialize(aligned), TailStrategy::RoundUp);
+                schedule_cpu(Halide::Stage(blur_y), TailStrategy::GuardWithIf);
+            } else {
+                schedule_cpu(Halide::Stage(blur_y), tail_strategy());
+            }
+            // blur_x reads the input directly, with no boundary
+            // condition, so it keeps the default tail strategy, and
+            // with it the input margin callers already provide.
             blur_x.store_at(blur_y, y).compute_at(blur_y, yi).vectorize(x, 8);
 
+            // Rows may be padded or stored bottom-up (any dim(1) stride)
+            // already. Also take any stride in x, e.g. one channel of an
+            // interleaved frame wrapped in place (see external_buffer.h),
+            // and keep dense vector loads for the usual stride of 1. Only
+            // blur_x reads the input, so it alone needs to specialize.
+            input.dim(0).set_stride(Expr());
+            blur_x.specialize(input.dim(0).stride() == 1);
+
             printf("Pseudo-code for the schedule:\n");
             blur_y.print_loop_nest();
             printf("\n");
@@ -145,6 +206,20 @@ public:
 
         }
     }
+
+    TailStrategy tail_strategy() const {
+        switch (tail) {
+        case BlurTail::ShiftInwards:
+            return TailStrategy::ShiftInwards;
+        case BlurTail::GuardWithIf:
+        case BlurTail::Epilogue:
+            return TailStrategy::GuardWithIf;
+        case BlurTail::RoundUp:
+            return TailStrategy::RoundUp;
+        default:
+            return TailStrategy::Auto;
+        }
+    }
 };
 
 }  // namespace
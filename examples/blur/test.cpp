@@ -1,6 +1,14 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <cstdio>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
 #ifdef __SSE2__
 #include <emmintrin.h>
 #elif __ARM_NEON
@@ -8,20 +16,35 @@
 #endif
 
 #include "HalideBuffer.h"
-#include "halide_benchmark.h"
+#include "async_pipeline.h"
+#include "external_buffer.h"
+#include "halide_bench.h"
+#include "huge_pages.h"
+#include "numa.h"
+#include "thread_budget.h"
 
 using namespace Halide::Runtime;
-using namespace Halide::Tools;
 
 double t;
 
+// Time f, which produces the given number of pixels, print its
+// statistics and leave the median in t.
+void time_it(const char *name, int pixels, const std::function<void()> &f) {
+    HalideBench::Options opts;
+    opts.samples = 10;
+    opts.pixels = pixels;
+    HalideBench::Stats stats = HalideBench::benchmark(name, opts, f);
+    printf("%s\n", stats.summary().c_str());
+    t = stats.median;
+}
+
 Buffer<uint16_t> blur(Buffer<uint16_t> in) {
     printf("\nblur_naive\n");
 
     Buffer<uint16_t> tmp(in.width() - 8, in.height());
     Buffer<uint16_t> out(in.width() - 8, in.height() - 2);
 
-    t = benchmark(10, 1, [&]() {
+    time_it("blur/naive", out.number_of_elements(), [&]() {
         for (int y = 0; y < tmp.height(); y++)
             for (int x = 0; x < tmp.width(); x++)
                 tmp(x, y) = (in(x, y) + in(x + 1, y) + in(x + 2, y)) / 3;
@@ -39,7 +62,7 @@ Buffer<uint16_t> blur_fast(Buffer<uint16_t> in) {
 
     Buffer<uint16_t> out(in.width() - 8, in.height() - 2);
 
-    t = benchmark(10, 1, [&]() {
+    time_it("blur/fast", out.number_of_elements(), [&]() {
 #ifdef __SSE2__
         // printf("\tSSE2\n");
         __m128i one_third = _mm_set1_epi16(21846);
@@ -143,6 +166,13 @@ Buffer<uint16_t> blur_fast(Buffer<uint16_t> in) {
 }
 
 #include "halide_blur.h"
+#include "halide_blur_budget.h"
+#include "halide_blur_parallel.h"
+#include "halide_blur_serial.h"
+#include "halide_blur_tail_epilogue.h"
+#include "halide_blur_tail_guard_with_if.h"
+#include "halide_blur_tail_round_up.h"
+#include "halide_blur_tail_shift_inwards.h"
 
 Buffer<uint16_t> blur_halide(Buffer<uint16_t> in) {
     printf("\nblur_halide\n");
@@ -154,7 +184,7 @@ Buffer<uint16_t> blur_halide(Buffer<uint16_t> in) {
     // Copy-out result if it's device buffer and dirty.
     out.copy_to_host();
 
-    t = benchmark(10, 1, [&]() {
+    time_it("blur/halide", out.number_of_elements(), [&]() {
         // Compute the same region of the output as blur_fast (i.e., we're
         // still being sloppy with boundary conditions)
         halide_blur(in, out);
@@ -167,7 +197,501 @@ Buffer<uint16_t> blur_halide(Buffer<uint16_t> in) {
     return out;
 }
 
+// The Halide blur again with the input, the output and the pipeline's
+// own allocations on huge pages. blur_y walks down columns of a 25 MB
+// frame, so with 4 KiB pages nearly every row it touches is another TLB
+// entry; HL_BENCH_COUNTERS=1 shows the dTLB misses of both runs.
+Buffer<uint16_t> blur_halide_huge_pages(Buffer<uint16_t> in, HalideSupport::HugePages mode) {
+    const char *mode_name = HalideSupport::huge_pages_name(mode);
+    printf("\nblur_halide (huge pages: %s)\n", mode_name);
+
+    HalideSupport::use_huge_pages(mode);
+    Buffer<uint16_t> huge_in = HalideSupport::copy_to_huge(in);
+    Buffer<uint16_t> out = HalideSupport::allocate_huge<uint16_t>(in.width() - 8, in.height() - 2);
+
+    halide_blur(huge_in, out);
+    out.copy_to_host();
+
+    std::string name = std::string("blur/halide_huge_pages_") + mode_name;
+    time_it(name.c_str(), out.number_of_elements(), [&]() {
+        halide_blur(huge_in, out);
+        out.device_sync();
+    });
+
+    out.copy_to_host();
+
+    long long backed = HalideSupport::huge_page_bytes_backed();
+    printf("%.1f MB asked for huge pages, %.1f MB backed by them\n",
+           HalideSupport::huge_page_bytes_requested() / 1e6, backed < 0 ? 0.0 : backed / 1e6);
+
+    return out;
+}
+
+// The fraction of the input rows that the first parallel loop of one
+// run read from memory on the node of the thread reading them
+double node_local_ratio(HalideSupport::NumaPool &pool, Buffer<uint16_t> in, Buffer<uint16_t> out) {
+    pool.clear_history();
+    halide_blur(in, out);
+    std::vector<std::vector<int>> loops = pool.history();
+    if (loops.empty()) {
+        return 0;
+    }
+    return HalideSupport::node_local_ratio(loops[0], HalideSupport::row_home_nodes(pool.topology(), in));
+}
+
+// The Halide blur on a thread pool pinned per NUMA node, first with
+// the input as main() wrote it, all on one node, then with a copy
+// whose rows were first touched by the node whose strips read them.
+Buffer<uint16_t> blur_halide_numa(Buffer<uint16_t> in, int simulated_nodes) {
+    HalideSupport::NumaPool pool(HalideSupport::numa_topology(simulated_nodes));
+    const HalideSupport::NumaTopology &topology = pool.topology();
+    printf("\nblur_halide (%d %sNUMA nodes)\n", (int)topology.nodes.size(), topology.simulated ? "simulated " : "");
+    pool.install();
+
+    Buffer<uint16_t> out(in.width() - 8, in.height() - 2);
+    halide_blur(in, out);
+
+    time_it("blur/halide_numa_serial_init", out.number_of_elements(), [&]() {
+        halide_blur(in, out);
+    });
+    double serial_time = t;
+    double serial_local = node_local_ratio(pool, in, out);
+
+    Buffer<uint16_t> local(nullptr, in.width(), in.height());
+    local.allocate();
+    HalideSupport::first_touch(pool, local, [&](Buffer<> rows) {
+        rows.as<uint16_t>().copy_from(in);
+    });
+
+    time_it("blur/halide_numa_first_touch", out.number_of_elements(), [&]() {
+        halide_blur(local, out);
+    });
+    double local_ratio = node_local_ratio(pool, local, out);
+
+    printf("serial init: %f, %.0f%% node-local; first touch: %f, %.0f%% node-local\n",
+           serial_time, serial_local * 100, t, local_ratio * 100);
+
+    pool.uninstall();
+    return out;
+}
+
+// Throughput of the Halide blur serving a stream of small requests
+// through an AsyncPipeline, with 1, 2, 4, ... up to max_in_flight of
+// them outstanding. Each request has its own input and output; the
+// caller copies the next frame into a free one (its host-side
+// preparation) while the earlier requests compute.
+Buffer<uint16_t> blur_halide_async(Buffer<uint16_t> in, int max_in_flight) {
+    printf("\nblur_halide (async, up to %d in flight)\n", max_in_flight);
+
+    const int requests = 64;
+    Buffer<uint16_t> frame = in.cropped(0, 0, std::min(in.width(), 968)).cropped(1, 0, std::min(in.height(), 542));
+    Buffer<uint16_t> out;
+
+    for (int n = 1;; n = std::min(n * 2, max_in_flight)) {
+        HalideSupport::AsyncPipeline async(n);
+        std::vector<Buffer<uint16_t>> ins, outs;
+        for (int i = 0; i < n; i++) {
+            ins.emplace_back(frame.width(), frame.height());
+            outs.emplace_back(frame.width() - 8, frame.height() - 2);
+        }
+        std::vector<std::future<int>> pending(n);
+
+        std::string name = "blur/halide_async_" + std::to_string(n);
+        time_it(name.c_str(), requests * outs[0].number_of_elements(), [&]() {
+            for (int r = 0; r < requests; r++) {
+                int slot = r % n;
+                if (pending[slot].valid() && pending[slot].get() != 0) {
+                    printf("halide_blur failed\n");
+                    abort();
+                }
+                ins[slot].copy_from(frame);
+                Buffer<uint16_t> request_in = ins[slot], request_out = outs[slot];
+                pending[slot] = async.submit([=]() { return halide_blur(request_in, request_out); });
+            }
+            async.wait_idle();
+        });
+        printf("%d in flight: %.1f requests/s\n", n, requests / t);
+
+        for (std::future<int> &f : pending) {
+            f.get();
+        }
+        out = outs[n - 1];
+        out.copy_to_host();
+        if (n == max_in_flight) {
+            break;
+        }
+    }
+
+    return out;
+}
+
+// The p-th percentile of samples, which get sorted
+double percentile(std::vector<double> &samples, double p) {
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, (size_t)(p * samples.size()))];
+}
+
+// Latency of small blur calls on the main thread while full-frame calls
+// run back to back on another: first with both unlimited, so the small
+// calls' loops queue behind the large ones' tasks in Halide's pool, then
+// with the large calls limited to budget threads and the small ones
+// inline.
+Buffer<uint16_t> blur_halide_budget(Buffer<uint16_t> in, int budget) {
+    printf("\nblur_halide (mixed workload, large calls limited to %d threads)\n", budget);
+    HalideSupport::install_thread_budgets();
+
+    Buffer<uint16_t> large_out(in.width() - 8, in.height() - 2);
+    Buffer<uint16_t> small_in = in.cropped(0, 0, std::min(in.width(), 264)).cropped(1, 0, std::min(in.height(), 130));
+    Buffer<uint16_t> small_out(small_in.width() - 8, small_in.height() - 2);
+    const int calls = 1000;
+
+    for (int limited = 0; limited < 2; limited++) {
+        HalideSupport::ThreadBudget large_budget, small_budget;
+        if (limited) {
+            large_budget.threads = budget;
+            small_budget = HalideSupport::ThreadBudget::for_pixels(small_out.number_of_elements(), budget);
+        }
+
+        std::atomic<bool> stop(false);
+        std::atomic<int> large_calls(0);
+        std::thread background([&]() {
+            while (!stop) {
+                halide_blur_budget(&large_budget, in, large_out);
+                large_calls++;
+            }
+        });
+        while (large_calls == 0) {
+            std::this_thread::yield();
+        }
+
+        std::vector<double> latencies;
+        const int large_before = large_calls;
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; i++) {
+            auto start = std::chrono::steady_clock::now();
+            halide_blur_budget(&small_budget, small_in, small_out);
+            latencies.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        const int large_done = large_calls - large_before;
+        stop = true;
+        background.join();
+
+        printf("%s: small calls p50 %.3f ms, p99 %.3f ms; %.1f large calls/s\n",
+               limited ? "budgeted " : "unlimited", percentile(latencies, 0.5) * 1e3,
+               percentile(latencies, 0.99) * 1e3, large_done / elapsed);
+    }
+
+    return small_out;
+}
+
+// What checking a Cancellation before every strip costs, and how long
+// after being cancelled, or after its deadline, a full-frame call
+// returns. Fails unless some calls of each kind do stop early.
+// Cancellation only reaches pipelines built with user_context, which
+// of the examples is halide_blur_budget alone.
+Buffer<uint16_t> blur_halide_cancel(Buffer<uint16_t> in) {
+    printf("\nblur_halide (cancellable)\n");
+    HalideSupport::install_thread_budgets();
+    using Clock = HalideSupport::Cancellation::Clock;
+
+    Buffer<uint16_t> out(in.width() - 8, in.height() - 2);
+    HalideSupport::Cancellation cancel;
+    HalideSupport::ThreadBudget plain, cancellable;
+    cancellable.cancel = &cancel;
+
+    halide_blur_budget(&plain, in, out);
+    time_it("blur/halide_uncancellable", out.number_of_elements(), [&]() {
+        halide_blur_budget(&plain, in, out);
+    });
+    double plain_time = t;
+
+    time_it("blur/halide_cancellable", out.number_of_elements(), [&]() {
+        halide_blur_budget(&cancellable, in, out);
+    });
+    cancel.reset();
+    if (halide_blur_budget(&cancellable, in, out) != 0) {
+        printf("halide_blur_budget failed without being cancelled\n");
+        abort();
+    }
+    const int strips = cancel.checks();
+    printf("%d strips per call, %.1f us overhead per strip\n", strips, (t - plain_time) / std::max(strips, 1) * 1e6);
+
+    // Cancel from another thread a quarter of the way through, or let a
+    // deadline there pass, and time how long the call takes to notice.
+    // A call on the image alone can finish within a strip or two of
+    // that, so these run on the image stacked four times over, which
+    // takes about four times plain_time.
+    Buffer<uint16_t> tall(in.width(), in.height() * 4);
+    for (int y = 0; y < tall.height(); y++) {
+        for (int x = 0; x < tall.width(); x++) {
+            tall(x, y) = in(x, y % in.height());
+        }
+    }
+    Buffer<uint16_t> scratch(tall.width() - 8, tall.height() - 2);
+    const auto quarter = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(plain_time));
+    for (int deadline = 0; deadline < 2; deadline++) {
+        std::vector<double> latencies;
+        for (int trial = 0; trial < 20; trial++) {
+            cancel.reset();
+            Clock::time_point stop_at = Clock::now() + quarter;
+            std::thread canceller;
+            if (deadline) {
+                cancel.set_deadline(stop_at);
+            } else {
+                canceller = std::thread([&]() {
+                    std::this_thread::sleep_until(stop_at);
+                    stop_at = Clock::now();
+                    cancel.cancel();
+                });
+            }
+            int result = halide_blur_budget(&cancellable, tall, scratch);
+            Clock::time_point returned = Clock::now();
+            if (canceller.joinable()) {
+                canceller.join();
+            }
+            if (result == HalideSupport::cancelled_error) {
+                latencies.push_back(std::chrono::duration<double>(returned - stop_at).count());
+            } else if (result != 0) {
+                printf("halide_blur_budget failed: %d\n", result);
+                abort();
+            }
+        }
+        if (latencies.empty()) {
+            printf("%s: every call finished first, nothing was cancelled\n", deadline ? "deadline" : "cancel");
+            abort();
+        }
+        const size_t stopped = latencies.size();
+        printf("%s: %d of 20 calls stopped early, returning after median %.3f ms, max %.3f ms\n",
+               deadline ? "deadline" : "cancel  ", (int)stopped, percentile(latencies, 0.5) * 1e3,
+               percentile(latencies, 1.0) * 1e3);
+    }
+
+    return out;
+}
+
+// Latency of the Halide blur on square crops from 64 to 1024 pixels,
+// with the generator's small-image branch (below small_size, 256), and
+// with each of its two schedules forced, to show where they cross over.
+// The parallel schedule's 128-wide vectors need at least 128 columns.
+Buffer<uint16_t> blur_halide_sizes(Buffer<uint16_t> in) {
+    printf("\nblur_halide (latency against size)\n");
+    printf("  size     default      serial    parallel\n");
+
+    typedef decltype(&halide_blur) BlurFn;
+    const BlurFn variants[] = {&halide_blur, &halide_blur_serial, &halide_blur_parallel};
+    const char *variant_names[] = {"default", "serial", "parallel"};
+    Buffer<uint16_t> out;
+
+    for (int size : {64, 96, 128, 192, 256, 384, 512, 768, 1024}) {
+        if (size + 8 > in.width() || size + 2 > in.height()) {
+            break;
+        }
+        Buffer<uint16_t> crop = in.cropped(0, 0, size + 8).cropped(1, 0, size + 2);
+        out = Buffer<uint16_t>(size, size);
+
+        HalideBench::Options opts;
+        opts.samples = 10;
+        // Enough calls per sample for the smallest sizes to register
+        opts.iterations = std::max(1, (1 << 20) / (size * size));
+        opts.pixels = size * size;
+
+        printf("%6d", size);
+        for (int v = 0; v < 3; v++) {
+            if (v == 2 && size < 128) {
+                printf("         n/a");
+                continue;
+            }
+            std::string name = std::string("blur/halide_size_") + variant_names[v] + "_" + std::to_string(size);
+            HalideBench::Stats stats = HalideBench::benchmark(name, opts, [&]() { variants[v](crop, out); });
+            printf("  %7.1f us", stats.median * 1e6);
+        }
+        printf("\n");
+        // Leave the default variant's output to be checked
+        halide_blur(crop, out);
+    }
+
+    return out;
+}
+
+// The other runs of the Halide blur must match the first exactly.
+void check_same(const char *what, Buffer<uint16_t> out, Buffer<uint16_t> reference) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            if (out(x, y) != reference(x, y)) {
+                printf("difference with %s at (%d,%d): %d %d\n", what, x, y, out(x, y), reference(x, y));
+                abort();
+            }
+        }
+    }
+}
+
+// The Halide blur built with each tail strategy, on output sizes that
+// leave remainders after the 128-wide vectors and 32-row strips, and on
+// one that doesn't. round_up computes a padded output, of which only
+// the requested part counts; every result is checked against reference.
+void blur_halide_tails(Buffer<uint16_t> in, Buffer<uint16_t> reference) {
+    printf("\nblur_halide (tail strategies, us per megapixel)\n");
+
+    typedef decltype(&halide_blur) BlurFn;
+    const BlurFn variants[] = {&halide_blur, &halide_blur_tail_shift_inwards, &halide_blur_tail_guard_with_if,
+                               &halide_blur_tail_round_up, &halide_blur_tail_epilogue};
+    const char *variant_names[] = {"auto", "shift_inwards", "guard_with_if", "round_up", "epilogue"};
+    const int round_up = 3;
+    const int sizes[][2] = {{1366, 768}, {1921, 1081}, {4001, 2001}, {2048, 1024}};
+
+    printf("       size");
+    for (const char *name : variant_names) {
+        printf("  %13s", name);
+    }
+    printf("\n");
+
+    for (const auto &size : sizes) {
+        const int width = size[0], height = size[1];
+        const int padded_width = (width + 127) / 128 * 128, padded_height = (height + 31) / 32 * 32;
+        if (padded_width + 8 > in.width() || padded_height + 2 > in.height()) {
+            continue;
+        }
+
+        HalideBench::Options opts;
+        opts.samples = 10;
+        opts.pixels = (double)width * height;
+
+        printf("%5dx%-5d", width, height);
+        for (int v = 0; v < 5; v++) {
+            const int out_width = v == round_up ? padded_width : width;
+            const int out_height = v == round_up ? padded_height : height;
+            Buffer<uint16_t> crop = in.cropped(0, 0, out_width + 8).cropped(1, 0, out_height + 2);
+            Buffer<uint16_t> out(out_width, out_height);
+
+            std::string name = std::string("blur/halide_tail_") + variant_names[v] + "_" +
+                               std::to_string(width) + "x" + std::to_string(height);
+            HalideBench::Stats stats = HalideBench::benchmark(name, opts, [&]() { variants[v](crop, out); });
+            printf("  %13.1f", stats.median * 1e12 / opts.pixels);
+
+            check_same(variant_names[v], out.cropped(0, 0, width).cropped(1, 0, height), reference);
+        }
+        printf("\n");
+    }
+}
+
+// The Halide blur reading frames in memory it doesn't own, the way a
+// capture library hands them over: rows padded to a 512-byte pitch,
+// the same stored bottom-up, and one channel of a two-channel
+// interleaved frame (an x stride of 2). Each is read in place through
+// wrap_frame, and copied into a dense buffer first for comparison.
+void blur_halide_external(Buffer<uint16_t> in, Buffer<uint16_t> reference) {
+    struct Case {
+        const char *name;
+        int channels;
+        bool bottom_up;
+    };
+    const Case cases[] = {{"padded", 1, false}, {"bottom_up", 1, true}, {"interleaved", 2, false}};
+
+    for (const Case &frame : cases) {
+        HalideSupport::FrameLayout layout;
+        layout.width = in.width();
+        layout.height = in.height();
+        layout.channels = frame.channels;
+        // Round the rows up to a 512-byte pitch, plus one more, so
+        // they're padded whatever the width.
+        layout.row_stride = (in.width() * frame.channels * sizeof(uint16_t) + 511) / 512 * 512 + 512;
+        layout.bottom_up = frame.bottom_up;
+        void *memory = HalideSupport::huge_page_malloc(layout.row_stride * layout.height);
+        Buffer<uint16_t> view = HalideSupport::wrap_frame<uint16_t>(memory, layout);
+        if (!memory || !view.defined()) {
+            printf("Could not wrap the %s frame\n", frame.name);
+            abort();
+        }
+        view.slice(2, 0);
+        view.copy_from(in);
+
+        printf("\nblur_halide (external frame: %s, x stride %d, row stride %d, rows aligned to %d bytes)\n",
+               frame.name, view.dim(0).stride(), view.dim(1).stride(), HalideSupport::row_alignment(*view.raw_buffer()));
+        Buffer<uint16_t> out(in.width() - 8, in.height() - 2);
+
+        std::string name = std::string("blur/halide_external_") + frame.name;
+        time_it(name.c_str(), out.number_of_elements(), [&]() { halide_blur(view, out); });
+        double in_place_time = t;
+        check_same(name.c_str(), out, reference);
+
+        name = std::string("blur/halide_copy_in_") + frame.name;
+        time_it(name.c_str(), out.number_of_elements(), [&]() {
+            Buffer<uint16_t> dense = view.copy();
+            halide_blur(dense, out);
+        });
+        check_same(name.c_str(), out, reference);
+        printf("in place: %1.2fx faster than copying in\n", t / in_place_time);
+
+        HalideSupport::huge_page_free(memory);
+    }
+}
+
+void show_usage_and_exit() {
+    fprintf(stderr,
+            "Usage: ./test [--huge-pages madvise|hugetlb] [--numa simulated_nodes] [--async max_in_flight]\n"
+            "              [--budget threads] [--cancel] [--sizes] [--tails] [--external]\n"
+            "\t--huge-pages also times the Halide blur with its buffers on 2 MiB pages\n"
+            "\t--numa also times it on threads pinned per NUMA node, with the input\n"
+            "\t       written by one thread and by each node; on a single-node machine\n"
+            "\t       the CPUs are split into this many simulated nodes\n"
+            "\t--async also measures the throughput of small requests with 1, 2, 4, ...\n"
+            "\t       up to this many outstanding at once\n"
+            "\t--budget also measures the latency of small calls next to large ones,\n"
+            "\t       unlimited and with the large ones limited to this many threads\n"
+            "\t--cancel also measures what checking for cancellation costs per strip,\n"
+            "\t       and how soon a cancelled call or one past its deadline returns\n"
+            "\t--sizes also times crops from 64x64 to 1024x1024 with the small-image\n"
+            "\t       schedule, the parallel one, and the generator's choice\n"
+            "\t--tails also times the blur built with each tail strategy on odd sizes\n"
+            "\t--external also times the blur reading padded, bottom-up and interleaved frames\n"
+            "\t           in place, against copying them into a buffer of its own first\n");
+    exit(1);
+}
+
 int main(int argc, char **argv) {
+    HalideSupport::HugePages huge_pages = HalideSupport::HugePages::Off;
+    int numa_nodes = 0;
+    int async_in_flight = 0;
+    int budget = 0;
+    bool cancel = false;
+    bool sizes = false;
+    bool tails = false;
+    bool external = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--huge-pages" && i + 1 < argc) {
+            if (!HalideSupport::parse_huge_pages(argv[++i], &huge_pages)) {
+                show_usage_and_exit();
+            }
+        } else if (arg == "--numa" && i + 1 < argc) {
+            numa_nodes = atoi(argv[++i]);
+            if (numa_nodes < 1) {
+                show_usage_and_exit();
+            }
+        } else if (arg == "--async" && i + 1 < argc) {
+            async_in_flight = atoi(argv[++i]);
+            if (async_in_flight < 1) {
+                show_usage_and_exit();
+            }
+        } else if (arg == "--budget" && i + 1 < argc) {
+            budget = atoi(argv[++i]);
+            if (budget < 1) {
+                show_usage_and_exit();
+            }
+        } else if (arg == "--cancel") {
+            cancel = true;
+        } else if (arg == "--sizes") {
+            sizes = true;
+        } else if (arg == "--tails") {
+            tails = true;
+        } else if (arg == "--external") {
+            external = true;
+        } else {
+            show_usage_and_exit();
+        }
+    }
+
     const auto *md = halide_blur_metadata();
     const bool is_hexagon = strstr(md->target, "hvx_128") || strstr(md->target, "hvx_64");
 
@@ -194,6 +718,41 @@ int main(int argc, char **argv) {
 
     printf("Image %dx%d process time: %f %f %f\n", width, height, slow_time, fast_time, halide_time);
 
+    if (huge_pages != HalideSupport::HugePages::Off) {
+        Buffer<uint16_t> huge = blur_halide_huge_pages(input, huge_pages);
+        printf("Huge pages (%s): %f (%1.2fx)\n",
+               HalideSupport::huge_pages_name(huge_pages), t, halide_time / t);
+        check_same("huge pages", huge, halide);
+    }
+
+    if (numa_nodes > 0) {
+        check_same("NUMA placement", blur_halide_numa(input, numa_nodes), halide);
+    }
+
+    if (async_in_flight > 0) {
+        check_same("async calls", blur_halide_async(input, async_in_flight), halide);
+    }
+
+    if (budget > 0) {
+        check_same("thread budgets", blur_halide_budget(input, budget), halide);
+    }
+
+    if (cancel) {
+        check_same("cancellation checks", blur_halide_cancel(input), halide);
+    }
+
+    if (sizes) {
+        check_same("small-image branch", blur_halide_sizes(input), halide);
+    }
+
+    if (tails) {
+        blur_halide_tails(input, halide);
+    }
+
+    if (external) {
+        blur_halide_external(input, halide);
+    }
+
     for (int y = 64; y < input.height() - 64; y++) {
         for (int x = 64; x < input.width() - 64; x++) {
             if (blurry(x, y) != speedy(x, y) || blurry(x, y) != halide(x, y)) {
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "HalideBuffer.h"
+#include "halide_image_io.h"
+
+#include "convert_image.h"
+#include "halide_bench.h"
+
+using Halide::Runtime::Buffer;
+
+// Bandwidth of the AOT conversion kernels against the scalar
+// ImageTypeConversion::convert_image from ImageIO, for every pair of
+// types in planar and interleaved layout, and of the layout
+// conversions against Buffer::copy_from.
+
+const char *type_name(halide_type_t t) {
+    if (t == halide_type_of<float>()) {
+        return "float32";
+    } else if (t == halide_type_of<uint8_t>()) {
+        return "uint8";
+    }
+    return "uint16";
+}
+
+Buffer<> make_image(halide_type_t type, int width, int height, int channels, bool interleaved) {
+    if (interleaved) {
+        return Buffer<>::make_interleaved(type, width, height, channels);
+    }
+    return Buffer<>(type, width, height, channels);
+}
+
+// A smooth gradient plus some noise, over the full range of the type.
+template<typename T>
+void fill(Buffer<T> im, float range) {
+    im.for_each_element([&](int x, int y, int c) {
+        float v = 0.5f + 0.25f * std::sin(x * 0.01f + c) * std::cos(y * 0.013f) + 0.2f * (rand() / (float)RAND_MAX);
+        im(x, y, c) = (T)(std::min(std::max(v, 0.0f), 1.0f) * range);
+    });
+}
+
+void fill_image(Buffer<> im) {
+    if (im.type() == halide_type_of<float>()) {
+        fill<float>(im, 1.0f);
+    } else if (im.type() == halide_type_of<uint8_t>()) {
+        fill<uint8_t>(im, 255.0f);
+    } else {
+        fill<uint16_t>(im, 65535.0f);
+    }
+}
+
+// Largest difference, in steps of the type (or absolute for floats).
+template<typename T>
+double max_difference(Buffer<T> a, Buffer<T> b) {
+    double max_diff = 0;
+    a.for_each_element([&](int x, int y, int c) {
+        max_diff = std::max(max_diff, std::abs((double)a(x, y, c) - (double)b(x, y, c)));
+    });
+    return max_diff;
+}
+
+double max_difference(Buffer<> a, Buffer<> b) {
+    if (a.type() == halide_type_of<float>()) {
+        return max_difference<float>(a, b);
+    } else if (a.type() == halide_type_of<uint8_t>()) {
+        return max_difference<uint8_t>(a, b);
+    }
+    return max_difference<uint16_t>(a, b);
+}
+
+int main(int argc, char **argv) {
+    const int width = 3840, height = 2160, channels = 3;
+    const int iters = 10;
+
+    const halide_type_t types[] = {halide_type_of<uint8_t>(), halide_type_of<uint16_t>(), halide_type_of<float>()};
+
+    bool ok = true;
+    for (bool interleaved : {false, true}) {
+        for (halide_type_t src_type : types) {
+            Buffer<> src = make_image(src_type, width, height, channels, interleaved);
+            fill_image(src);
+
+            for (halide_type_t dst_type : types) {
+                if (src_type == dst_type) {
+                    continue;
+                }
+
+                Buffer<> dst = make_image(dst_type, width, height, channels, interleaved);
+                std::string name = std::string("convert/") + (interleaved ? "interleaved/" : "planar/") +
+                                   type_name(src_type) + "_to_" + type_name(dst_type);
+                double halide_time = HalideBench::benchmark(name + "/halide", iters, iters, [&]() {
+                    ImageConvert::convert_image_into(src, dst);
+                }).median;
+
+                Buffer<> reference;
+                double helper_time = HalideBench::benchmark(name + "/convert_image", iters, 1, [&]() {
+                    reference = Halide::Tools::ImageTypeConversion::convert_image(src, dst_type);
+                }).median;
+
+                // Conversions to integers round here and may truncate in
+                // ImageIO, so allow one step of difference.
+                double diff = max_difference(dst, reference);
+                double tolerance = dst_type.code == halide_type_float ? 1e-6 : 1.0;
+                if (diff > tolerance) {
+                    ok = false;
+                }
+
+                double bytes = (double)width * height * channels * (src_type.bytes() + dst_type.bytes());
+                printf("%-11s  %7s -> %-7s  halide: %7.3f ms %6.2f GB/s  convert_image: %8.3f ms %6.2f GB/s  (%5.1fx)  max diff: %g\n",
+                       interleaved ? "interleaved" : "planar", type_name(src_type), type_name(dst_type),
+                       halide_time * 1000, bytes / halide_time / 1e9,
+                       helper_time * 1000, bytes / helper_time / 1e9,
+                       helper_time / halide_time, diff);
+            }
+        }
+    }
+
+    // Layout conversions, each checked by converting back.
+    for (halide_type_t type : types) {
+        Buffer<> planar = make_image(type, width, height, 3, false);
+        fill_image(planar);
+        Buffer<> rgb = make_image(type, width, height, 3, true);
+        Buffer<> rgba = make_image(type, width, height, 4, true);
+        Buffer<> rgb_back = make_image(type, width, height, 3, true);
+        Buffer<> planar_back = make_image(type, width, height, 3, false);
+
+        struct LayoutCase {
+            const char *name, *id;
+            Buffer<> src, dst;
+        } cases[] = {
+            {"planar -> rgb", "planar_to_rgb", planar, rgb},
+            {"rgb -> rgba", "rgb_to_rgba", rgb, rgba},
+            {"rgba -> rgb", "rgba_to_rgb", rgba, rgb_back},
+            {"rgb -> planar", "rgb_to_planar", rgb_back, planar_back},
+        };
+
+        for (LayoutCase &lc : cases) {
+            std::string name = std::string("convert_layout/") + type_name(type) + "/" + lc.id;
+            double halide_time = HalideBench::benchmark(name + "/halide", iters, iters, [&]() {
+                if (ImageConvert::convert_layout_into(lc.src, lc.dst) != 0) {
+                    ok = false;
+                }
+            }).median;
+
+            // copy_from only moves the channels both sides have.
+            int common = std::min(lc.src.channels(), lc.dst.channels());
+            Buffer<> reference = make_image(type, width, height, lc.dst.channels(), lc.dst.dim(2).stride() == 1);
+            Buffer<> reference_dst = reference.cropped(2, 0, common);
+            Buffer<> reference_src = lc.src.cropped(2, 0, common);
+            double copy_time = HalideBench::benchmark(name + "/copy_from", iters, 1, [&]() {
+                reference_dst.copy_from(reference_src);
+            }).median;
+
+            double bytes = (double)width * height * (lc.src.channels() + lc.dst.channels()) * type.bytes();
+            printf("%-7s  %-13s  halide: %7.3f ms %6.2f GB/s  copy_from: %8.3f ms %6.2f GB/s  (%5.1fx)\n",
+                   type_name(type), lc.name,
+                   halide_time * 1000, bytes / halide_time / 1e9,
+                   copy_time * 1000, bytes / copy_time / 1e9,
+                   copy_time / halide_time);
+        }
+
+        if (max_difference(planar, planar_back) != 0 || max_difference(rgb, rgb_back) != 0) {
+            printf("%s layout conversions did not round-trip\n", type_name(type));
+            ok = false;
+        }
+    }
+
+    // The drop-in path through a freshly allocated buffer should keep
+    // the layout it was given.
+    Buffer<> packed = make_image(halide_type_of<uint8_t>(), 64, 48, 4, true);
+    fill_image(packed);
+    Buffer<> converted = ImageConvert::convert_image(packed, halide_type_of<float>());
+    if (converted.dim(2).stride() != 1 || max_difference(converted, Halide::Tools::ImageTypeConversion::convert_image(packed, halide_type_of<float>())) > 1e-6) {
+        printf("convert_image did not preserve the interleaved layout\n");
+        ok = false;
+    }
+
+    if (!ok) {
+        printf("Conversion results are wrong\n");
+        return 1;
+    }
+    printf("Success!\n");
+    return 0;
+}
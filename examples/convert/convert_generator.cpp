@@ -0,0 +1,157 @@
+#include "Halide.h"
+
+#include "value_range.h"
+
+using namespace Halide;
+
+namespace {
+
+// Converts an image between element types, normalizing the values:
+// float images hold [0, 1], integer images use the full range of the
+// type. Going to an integer type rounds to nearest and saturates, so
+// out-of-range floats clamp to 0 and the maximum.
+class Convert : public Halide::Generator<Convert> {
+public:
+    Input<Buffer<>> input{"input", 3};
+    Output<Buffer<>> output{"output", 3};
+
+    Var x{"x"}, y{"y"}, c{"c"}, yi{"yi"};
+
+    void generate() {
+        Type in_t = input.type(), out_t = output.type();
+        Expr v = input(x, y, c);
+
+        if (in_t.is_float() && out_t.is_float()) {
+            output(x, y, c) = cast(out_t, v);
+        } else if (out_t.is_float()) {
+            output(x, y, c) = cast(out_t, cast<float>(v) * (1.0f / value_range(in_t)));
+        } else if (in_t.is_float()) {
+            Expr scaled = clamp(cast<float>(v), 0.0f, 1.0f) * value_range(out_t) + 0.5f;
+            output(x, y, c) = cast(out_t, scaled);
+        } else {
+            // Between integer types, rescale exactly in 32 bits:
+            // uint8 -> uint16 multiplies by 257, uint16 -> uint8 divides
+            // by 257 with rounding.
+            Expr in_max = cast<uint32_t>(in_t.max());
+            Expr out_max = cast<uint32_t>(out_t.max());
+            output(x, y, c) = cast(out_t, (cast<uint32_t>(v) * out_max + in_max / 2) / in_max);
+        }
+    }
+
+    void schedule() {
+        Type in_t = input.type(), out_t = output.type();
+        // Fill whole vectors of the narrower of the two types.
+        const int vector_size = natural_vector_size(in_t.bits() < out_t.bits() ? in_t : out_t);
+
+        output
+            .split(y, y, yi, 16)
+            .reorder(x, yi, c, y)
+            .parallel(y)
+            .vectorize(x, vector_size);
+
+        // As in the resize app, accept any memory layout and specialize
+        // for planar and for packed RGB/RGBA on both sides.
+        output.dim(0).set_stride(Expr());
+        input.dim(0).set_stride(Expr());
+
+        Expr planar = (output.dim(0).stride() == 1 &&
+                       input.dim(0).stride() == 1);
+        output.specialize(planar);
+
+        for (int channels : {3, 4}) {
+            Expr packed = (output.dim(0).stride() == channels &&
+                           output.dim(2).stride() == 1 &&
+                           output.dim(2).min() == 0 &&
+                           output.dim(2).extent() == channels &&
+                           input.dim(0).stride() == channels &&
+                           input.dim(2).stride() == 1 &&
+                           input.dim(2).min() == 0 &&
+                           input.dim(2).extent() == channels);
+            output.specialize(packed)
+                .reorder(c, x, yi, y)
+                .unroll(c);
+        }
+    }
+};
+
+enum class LayoutOp {
+    PlanarToInterleaved,
+    InterleavedToPlanar,
+    RGBToRGBA,  // Both interleaved; alpha is set to opaque
+    RGBAToRGB,  // Both interleaved; alpha is dropped
+};
+
+// Copies an image into another memory layout without changing the
+// element type.
+class ConvertLayout : public Halide::Generator<ConvertLayout> {
+public:
+    GeneratorParam<LayoutOp> op{"op", LayoutOp::PlanarToInterleaved,
+                                {{"planar_to_interleaved", LayoutOp::PlanarToInterleaved},
+                                 {"interleaved_to_planar", LayoutOp::InterleavedToPlanar},
+                                 {"rgb_to_rgba", LayoutOp::RGBToRGBA},
+                                 {"rgba_to_rgb", LayoutOp::RGBAToRGB}}};
+
+    Input<Buffer<>> input{"input", 3};
+    Output<Buffer<>> output{"output", 3};
+
+    Var x{"x"}, y{"y"}, c{"c"}, yi{"yi"};
+
+    void generate() {
+        Type t = output.type();
+        user_assert(input.type() == t) << "convert_layout doesn't change the element type\n";
+
+        if (op == LayoutOp::RGBToRGBA) {
+            Expr opaque = t.is_float() ? cast(t, 1.0f) : t.max();
+            output(x, y, c) = select(c == 3, opaque, input(x, y, min(c, 2)));
+        } else {
+            output(x, y, c) = input(x, y, c);
+        }
+    }
+
+    void schedule() {
+        const bool interleaved_in = op != LayoutOp::PlanarToInterleaved;
+        const bool interleaved_out = op != LayoutOp::InterleavedToPlanar;
+        if (interleaved_in) {
+            input.dim(0).set_stride(input.dim(2).extent());
+            input.dim(2).set_stride(1);
+        }
+        if (interleaved_out) {
+            output.dim(0).set_stride(output.dim(2).extent());
+            output.dim(2).set_stride(1);
+        }
+
+        output
+            .split(y, y, yi, 16)
+            .parallel(y)
+            .vectorize(x, natural_vector_size(output.type()));
+
+        // With the channel loop innermost and unrolled, each vector of
+        // x covers all channels of those pixels. Strided loads from an
+        // interleaved input become dense loads plus deinterleaving
+        // shuffles, and strided stores to an interleaved output become
+        // interleaving shuffles plus dense stores.
+        if (op == LayoutOp::RGBToRGBA || op == LayoutOp::RGBAToRGB) {
+            const int in_channels = op == LayoutOp::RGBToRGBA ? 3 : 4;
+            const int out_channels = 7 - in_channels;
+            input.dim(2).set_bounds(0, in_channels);
+            output.dim(2).set_bounds(0, out_channels);
+            output
+                .bound(c, 0, out_channels)
+                .reorder(c, x, yi, y)
+                .unroll(c);
+        } else {
+            // Other channel counts walk one plane at a time.
+            output.reorder(x, yi, c, y);
+            for (int channels : {3, 4}) {
+                output.specialize(output.dim(2).extent() == channels)
+                    .reorder(c, x, yi, y)
+                    .unroll(c);
+            }
+        }
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(Convert, convert)
+HALIDE_REGISTER_GENERATOR(ConvertLayout, convert_layout)
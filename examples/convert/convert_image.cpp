@@ -0,0 +1,161 @@
+#include "convert_image.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "halide_image_io.h"
+
+#include "convert_float32_to_uint16.h"
+#include "convert_float32_to_uint8.h"
+#include "convert_layout_interleaved_to_planar_float32.h"
+#include "convert_layout_interleaved_to_planar_uint16.h"
+#include "convert_layout_interleaved_to_planar_uint8.h"
+#include "convert_layout_planar_to_interleaved_float32.h"
+#include "convert_layout_planar_to_interleaved_uint16.h"
+#include "convert_layout_planar_to_interleaved_uint8.h"
+#include "convert_layout_rgb_to_rgba_float32.h"
+#include "convert_layout_rgb_to_rgba_uint16.h"
+#include "convert_layout_rgb_to_rgba_uint8.h"
+#include "convert_layout_rgba_to_rgb_float32.h"
+#include "convert_layout_rgba_to_rgb_uint16.h"
+#include "convert_layout_rgba_to_rgb_uint8.h"
+#include "convert_uint16_to_float32.h"
+#include "convert_uint16_to_uint8.h"
+#include "convert_uint8_to_float32.h"
+#include "convert_uint8_to_uint16.h"
+
+using Halide::Runtime::Buffer;
+
+namespace ImageConvert {
+
+namespace {
+
+typedef decltype(&convert_uint8_to_float32) ConvertFn;
+
+int type_index(halide_type_t t) {
+    if (t == halide_type_of<float>()) {
+        return 0;
+    } else if (t == halide_type_of<uint8_t>()) {
+        return 1;
+    } else if (t == halide_type_of<uint16_t>()) {
+        return 2;
+    }
+    return -1;
+}
+
+ConvertFn find_convert_variant(halide_type_t src, halide_type_t dst) {
+    static const ConvertFn variants[3][3] =
+        {{nullptr, &convert_float32_to_uint8, &convert_float32_to_uint16},
+         {&convert_uint8_to_float32, nullptr, &convert_uint8_to_uint16},
+         {&convert_uint16_to_float32, &convert_uint16_to_uint8, nullptr}};
+
+    int src_idx = type_index(src), dst_idx = type_index(dst);
+    if (src_idx < 0 || dst_idx < 0) {
+        return nullptr;
+    }
+    return variants[src_idx][dst_idx];
+}
+
+// The kernels are 3-dimensional; view gray images as one channel.
+Buffer<> with_channels(const Buffer<> &im) {
+    Buffer<> view = im;
+    if (view.dimensions() == 2) {
+        view.embed(2, 0);
+    }
+    return view;
+}
+
+typedef decltype(&convert_layout_planar_to_interleaved_uint8) LayoutFn;
+
+bool is_interleaved(const Buffer<> &im) {
+    return im.dim(2).stride() == 1 && im.dim(0).stride() == im.channels();
+}
+
+LayoutFn find_layout_variant(const Buffer<> &src, const Buffer<> &dst) {
+    static const LayoutFn variants[4][3] =
+        {{&convert_layout_planar_to_interleaved_float32, &convert_layout_planar_to_interleaved_uint8, &convert_layout_planar_to_interleaved_uint16},
+         {&convert_layout_interleaved_to_planar_float32, &convert_layout_interleaved_to_planar_uint8, &convert_layout_interleaved_to_planar_uint16},
+         {&convert_layout_rgb_to_rgba_float32, &convert_layout_rgb_to_rgba_uint8, &convert_layout_rgb_to_rgba_uint16},
+         {&convert_layout_rgba_to_rgb_float32, &convert_layout_rgba_to_rgb_uint8, &convert_layout_rgba_to_rgb_uint16}};
+
+    int type_idx = type_index(src.type());
+    if (type_idx < 0 || src.type() != dst.type()) {
+        return nullptr;
+    }
+    int op = -1;
+    if (src.channels() == dst.channels()) {
+        if (src.dim(0).stride() == 1 && is_interleaved(dst)) {
+            op = 0;
+        } else if (is_interleaved(src) && dst.dim(0).stride() == 1) {
+            op = 1;
+        }
+    } else if (is_interleaved(src) && is_interleaved(dst)) {
+        if (src.channels() == 3 && dst.channels() == 4) {
+            op = 2;
+        } else if (src.channels() == 4 && dst.channels() == 3) {
+            op = 3;
+        }
+    }
+    return op < 0 ? nullptr : variants[op][type_idx];
+}
+
+}  // namespace
+
+Buffer<> convert_image(const Buffer<> &im, halide_type_t dst_type) {
+    if (im.type() == dst_type) {
+        return im;
+    }
+
+    Buffer<> src = with_channels(im);
+    Buffer<> dst;
+    if (src.dim(2).stride() == 1 && src.channels() > 1) {
+        dst = Buffer<>::make_interleaved(dst_type, src.width(), src.height(), src.channels());
+    } else {
+        dst = Buffer<>(dst_type, src.width(), src.height(), src.channels());
+    }
+    dst.translate({src.dim(0).min(), src.dim(1).min(), src.dim(2).min()});
+
+    if (convert_image_into(src, dst) != 0) {
+        return Buffer<>();
+    }
+    return im.dimensions() == 2 ? dst.sliced(2, dst.dim(2).min()) : dst;
+}
+
+int convert_image_into(const Buffer<> &src, Buffer<> &dst) {
+    ConvertFn fn = find_convert_variant(src.type(), dst.type());
+    if (!fn) {
+        return -1;
+    }
+    Buffer<> in = with_channels(src), out = with_channels(dst);
+    return fn(in, out);
+}
+
+int convert_layout_into(const Buffer<> &src, Buffer<> &dst) {
+    if (src.dimensions() != 3 || dst.dimensions() != 3) {
+        return -1;
+    }
+    LayoutFn fn = find_layout_variant(src, dst);
+    if (!fn) {
+        return -1;
+    }
+    Buffer<> in = src;
+    return fn(in, dst);
+}
+
+bool convert_and_save_image(const Buffer<> &im, const std::string &filename) {
+    Buffer<> to_save = im;
+    if (im.type().code == halide_type_float) {
+        // Formats that store floats (.tmp, .mat) take the image as it
+        // is; 8-bit-only formats get uint8 and the rest uint16.
+        std::string ext = filename.substr(filename.find_last_of('.') + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext == "jpg" || ext == "jpeg") {
+            to_save = convert_image(im, halide_type_of<uint8_t>());
+        } else if (ext != "tmp" && ext != "mat") {
+            to_save = convert_image(im, halide_type_of<uint16_t>());
+        }
+    }
+    return Halide::Tools::save(to_save, filename);
+}
+
+}  // namespace ImageConvert
@@ -0,0 +1,44 @@
+#ifndef CONVERT_IMAGE_H
+#define CONVERT_IMAGE_H
+
+// Drop-in replacements for Halide::Tools::ImageTypeConversion::convert_image
+// and Halide::Tools::convert_and_save_image, backed by the vectorized,
+// multithreaded AOT kernels of convert_generator.cpp.
+//
+// Values are normalized the same way: float images hold [0, 1] and
+// integer images use the full range of their type. Unlike the ImageIO
+// helpers, conversions to an integer type round to nearest and
+// saturate, so results can differ from them by one step.
+
+#include <string>
+
+#include "HalideBuffer.h"
+
+namespace ImageConvert {
+
+// Convert between any two of uint8, uint16 and float32, keeping the
+// memory layout of im (planar or interleaved). 2- and 3-dimensional
+// images are supported. Returns im itself if it already has the
+// requested type.
+Halide::Runtime::Buffer<> convert_image(const Halide::Runtime::Buffer<> &im, halide_type_t dst_type);
+
+// Convert into an existing buffer of the same shape, e.g. one taken
+// from a pool. Returns the Halide error code, or -1 if the pair of
+// types isn't supported.
+int convert_image_into(const Halide::Runtime::Buffer<> &src, Halide::Runtime::Buffer<> &dst);
+
+// Copy src into dst, which has the same element type but another
+// memory layout: planar to interleaved or back with any number of
+// channels, or interleaved RGB to interleaved RGBA (opaque alpha) or
+// back. Returns the Halide error code, or -1 if the combination isn't
+// supported.
+int convert_layout_into(const Halide::Runtime::Buffer<> &src, Halide::Runtime::Buffer<> &dst);
+
+// Like Halide::Tools::convert_and_save_image: save im, converting it
+// first to a type the file format supports if it needs to. Returns
+// false if saving fails.
+bool convert_and_save_image(const Halide::Runtime::Buffer<> &im, const std::string &filename);
+
+}  // namespace ImageConvert
+
+#endif  // CONVERT_IMAGE_H
@@ -1,47 +1,102 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <vector>
 
 #include "HalideBuffer.h"
-#include "halide_benchmark.h"
 #include "halide_image_io.h"
 
-#include "resize_box_float32_down.h"
-#include "resize_box_float32_up.h"
-#include "resize_box_uint16_down.h"
-#include "resize_box_uint16_up.h"
-#include "resize_box_uint8_down.h"
-#include "resize_box_uint8_up.h"
-#include "resize_cubic_float32_down.h"
-#include "resize_cubic_float32_up.h"
-#include "resize_cubic_uint16_down.h"
-#include "resize_cubic_uint16_up.h"
-#include "resize_cubic_uint8_down.h"
-#include "resize_cubic_uint8_up.h"
-#include "resize_lanczos_float32_down.h"
-#include "resize_lanczos_float32_up.h"
-#include "resize_lanczos_uint16_down.h"
-#include "resize_lanczos_uint16_up.h"
-#include "resize_lanczos_uint8_down.h"
-#include "resize_lanczos_uint8_up.h"
-#include "resize_linear_float32_down.h"
-#include "resize_linear_float32_up.h"
-#include "resize_linear_uint16_down.h"
-#include "resize_linear_uint16_up.h"
-#include "resize_linear_uint8_down.h"
-#include "resize_linear_uint8_up.h"
-
-std::string infile, outfile, input_type, interpolation_type;
-float scale_factor = 1.0f;
+#include "resize_box_float32_f16.h"
+#include "resize_cubic_float32_f16.h"
+#include "resize_cubic_float32_prefilter1.h"
+#include "resize_cubic_float32_prefilter2.h"
+#include "resize_cubic_float32_prefilter3.h"
+#include "resize_cubic_uint8_float32_parallel.h"
+#include "resize_cubic_uint8_float32_serial.h"
+#include "resize_cubic_uint8_float32_tail_epilogue.h"
+#include "resize_cubic_uint8_float32_tail_guard_with_if.h"
+#include "resize_cubic_uint8_float32_tail_round_up.h"
+#include "resize_cubic_uint8_float32_tail_shift_inwards.h"
+#include "resize_extern_decode.h"
+#include "resize_kernel_cubic_exact.h"
+#include "resize_kernel_cubic_fast.h"
+#include "resize_kernel_lanczos_exact.h"
+#include "resize_kernel_lanczos_fast.h"
+#include "resize_lanczos_float32_f16.h"
+#include "resize_lanczos_float32_prefilter1.h"
+#include "resize_lanczos_float32_prefilter2.h"
+#include "resize_lanczos_float32_prefilter3.h"
+#include "resize_linear_float32_f16.h"
+#include "resize_predecoded.h"
+#include "convert_image.h"
+#include "external_buffer.h"
+#include "halide_bench.h"
+#include "huge_pages.h"
+#include "numa.h"
+#include "resize_batch.h"
+#include "resize_daemon.h"
+#include "resize_variants.h"
+#include "row_codec.h"
+
+std::string infile, outfile, output_type, interpolation_type;
+float scale_x = 1.0f, scale_y = 1.0f;
+std::string pass_order = "auto";
 int benchmark_iters = 10;
 bool packed = true;
+bool kernel_setup = false;
+bool multistage = false;
+bool half_intermediates = false;
+bool latency_sizes = false;
+bool tails = false;
+bool extern_decode = false;
+bool external_frames = false;
+bool batch = false;
+int queue_depth = 4;
+int codec_threads = 2;
+HalideSupport::HugePages huge_pages = HalideSupport::HugePages::Off;
+int numa_nodes = 0;
+
+// file with suffix inserted before its extension, if it has one
+std::string with_suffix(const std::string &file, const std::string &suffix) {
+    size_t dot = file.find_last_of('.');
+    size_t slash = file.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return file + suffix;
+    }
+    return file.substr(0, dot) + suffix + file.substr(dot);
+}
 
 void show_usage_and_exit() {
     fprintf(stderr,
             "Usage:\n"
-            "\t./resample [-f scalefactor] "
+            "\t./resample [-f scalefactor] [-fx scalefactor] [-fy scalefactor] "
+            "[-o auto|x|y|compare] "
             "[-b benchmark_iterations] "
             "[-i box|linear|cubic|lanczos] "
-            "[-t float32|uint8|uint16] in.png out.png\n");
+            "[-t float32|uint8|uint16] "
+            "[-k] [-m] [--half] [-l] [-T] [-d] [-e] [--huge-pages madvise|hugetlb] [--numa simulated_nodes] in.png out.png\n"
+            "\t./resample --batch [-q queue_depth] [-j codec_threads] [-i ...] [-t ...] [-f ...] list.txt out_dir\n"
+            "\t./resample --daemon [socket_path]\n"
+            "\t-k also benchmarks computing the cubic/lanczos weights alone\n"
+            "\t-m also downsamples by 2x box steps first, then resizes the rest, and saves that\n"
+            "\t   next to out.png with a _multistage suffix (out_multistage.png)\n"
+            "\t-o forces which axis is resampled first, or benchmarks both\n"
+            "\t-t is the output type; the input is read in the type it decodes to\n"
+            "\t--half compares against storing the intermediate in float16 (8-bit input, float32 output only)\n"
+            "\t-l times cubic 8-bit to float32 resizes to 64x64 up to 1024x1024, with the small-output\n"
+            "\t   schedule, the parallel one, and the generator's choice\n"
+            "\t-T times cubic 8-bit to float32 resizes to awkward output sizes with each tail strategy\n"
+            "\t-d compares decoding the whole image before a cubic float32 resize against decoding\n"
+            "\t   each strip's rows inside the pipeline, with a simple row codec (8-bit input only)\n"
+            "\t-e times cubic float32 resizes reading padded, bottom-up interleaved and planar frames\n"
+            "\t   in place, against copying them to a planar buffer first (8-bit input only)\n"
+            "\t--huge-pages puts the images and the pipeline's own buffers on 2 MiB pages\n"
+            "\t--numa runs on threads pinned per NUMA node, with the input first touched by\n"
+            "\t       the node that reads it; a single-node machine simulates this many nodes\n"
+            "\t--batch resizes every file in list.txt, overlapping decode, resize and encode\n"
+            "\t--daemon serves resize jobs from stdin or a Unix socket, see resize_daemon.h\n");
     exit(1);
 }
 
@@ -49,15 +104,47 @@ void parse_commandline(int argc, char **argv) {
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
         if (arg == "-f" && i + 1 < argc) {
-            scale_factor = atof(argv[++i]);
+            scale_x = scale_y = atof(argv[++i]);
+        } else if (arg == "-fx" && i + 1 < argc) {
+            scale_x = atof(argv[++i]);
+        } else if (arg == "-fy" && i + 1 < argc) {
+            scale_y = atof(argv[++i]);
+        } else if (arg == "-o" && i + 1 < argc) {
+            pass_order = argv[++i];
         } else if (arg == "-i" && i + 1 < argc) {
             interpolation_type = argv[++i];
         } else if (arg == "-t" && i + 1 < argc) {
-            input_type = argv[++i];
+            output_type = argv[++i];
         } else if (arg == "-b" && i + 1 < argc) {
             benchmark_iters = atoi(argv[++i]);
         } else if (arg == "-p" && i + 1 < argc) {
             packed = atoi(argv[++i]) != 0;
+        } else if (arg == "-k") {
+            kernel_setup = true;
+        } else if (arg == "-m") {
+            multistage = true;
+        } else if (arg == "--half") {
+            half_intermediates = true;
+        } else if (arg == "-l") {
+            latency_sizes = true;
+        } else if (arg == "-T") {
+            tails = true;
+        } else if (arg == "-d") {
+            extern_decode = true;
+        } else if (arg == "-e") {
+            external_frames = true;
+        } else if (arg == "--huge-pages" && i + 1 < argc) {
+            if (!HalideSupport::parse_huge_pages(argv[++i], &huge_pages)) {
+                show_usage_and_exit();
+            }
+        } else if (arg == "--numa" && i + 1 < argc) {
+            numa_nodes = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--batch") {
+            batch = true;
+        } else if (arg == "-q" && i + 1 < argc) {
+            queue_depth = std::max(1, atoi(argv[++i]));
+        } else if (arg == "-j" && i + 1 < argc) {
+            codec_threads = std::max(1, atoi(argv[++i]));
         } else if (infile.empty()) {
             infile = arg;
         } else if (outfile.empty()) {
@@ -73,95 +160,511 @@ void parse_commandline(int argc, char **argv) {
     }
 }
 
+// Name under which HalideBench records one measurement of this run
+std::string bench_name(const char *what) {
+    char buf[160];
+    std::string variant = huge_pages == HalideSupport::HugePages::Off ? "" : std::string("_huge_pages_") + HalideSupport::huge_pages_name(huge_pages);
+    if (numa_nodes > 0) {
+        variant += "_numa" + std::to_string(numa_nodes);
+    }
+    snprintf(buf, sizeof(buf), "resize/%s%s/%s/%s/%gx%g", what, variant.c_str(), interpolation_type.c_str(), output_type.c_str(), scale_x, scale_y);
+    return buf;
+}
+
+// benchmark_iters samples of benchmark_iters calls, each producing the
+// given number of pixels (for the hardware counters, HL_BENCH_COUNTERS)
+HalideBench::Options bench_options(double pixels) {
+    HalideBench::Options opts;
+    opts.samples = benchmark_iters;
+    opts.iterations = benchmark_iters;
+    opts.pixels = pixels;
+    return opts;
+}
+
+// Time computing the normalized resampling weights of one axis with
+// the closed-form kernel and with the tabulated one, separately from
+// the convolution that consumes them.
+void benchmark_kernel_setup(int out_width) {
+    decltype(&resize_kernel_cubic_fast) exact_fn, fast_fn;
+    int taps;
+    if (interpolation_type == "cubic") {
+        exact_fn = &resize_kernel_cubic_exact;
+        fast_fn = &resize_kernel_cubic_fast;
+        taps = 4;
+    } else if (interpolation_type == "lanczos") {
+        exact_fn = &resize_kernel_lanczos_exact;
+        fast_fn = &resize_kernel_lanczos_fast;
+        taps = 6;
+    } else {
+        printf("kernel  %8s  not tabulated, skipping kernel setup benchmark\n",
+               interpolation_type.c_str());
+        return;
+    }
+
+    int max_taps = (int)std::ceil(taps / std::min(scale_x, 1.0f));
+    Halide::Runtime::Buffer<float> exact(out_width, max_taps), fast(out_width, max_taps);
+
+    double exact_time = HalideBench::benchmark(bench_name("kernel_exact"), benchmark_iters, benchmark_iters, [&]() { exact_fn(scale_x, exact); }).median;
+    double fast_time = HalideBench::benchmark(bench_name("kernel_table"), benchmark_iters, benchmark_iters, [&]() { fast_fn(scale_x, fast); }).median;
+
+    float max_error = 0.0f;
+    exact.for_each_element([&](int x, int k) {
+        max_error = std::max(max_error, std::abs(exact(x, k) - fast(x, k)));
+    });
+
+    printf("kernel  %8s  %1.2f  %d taps  exact: %f ms  table: %f ms  max error: %g\n",
+           interpolation_type.c_str(), scale_x, max_taps,
+           exact_time * 1000, fast_time * 1000, max_error);
+}
+
+struct ImageError {
+    double max_abs, rms, psnr;
+};
+
+// Difference between two float images in [0, 1].
+ImageError compare_images(const Halide::Runtime::Buffer<float> &a, const Halide::Runtime::Buffer<float> &b) {
+    double sum_sq = 0, max_abs = 0;
+    a.for_each_element([&](int x, int y, int c) {
+        double d = a(x, y, c) - b(x, y, c);
+        sum_sq += d * d;
+        max_abs = std::max(max_abs, std::abs(d));
+    });
+    double mse = sum_sq / a.number_of_elements();
+    double psnr = mse > 0 ? 10 * std::log10(1.0 / mse) : std::numeric_limits<double>::infinity();
+    return {max_abs, std::sqrt(mse), psnr};
+}
+
+// Pick the multi-stage variant that leaves a remaining ratio in
+// (0.25, 0.5] for the final resize, or nullptr if there is none.
+// Like the float16 variants, these read uint8 and write float32.
+decltype(&resize_lanczos_float32_prefilter1) pick_multistage(halide_type_t input_type, int *levels) {
+    decltype(&resize_lanczos_float32_prefilter1) multistage_variants[2][3] =
+        {
+            {&resize_cubic_float32_prefilter1,
+             &resize_cubic_float32_prefilter2,
+             &resize_cubic_float32_prefilter3},
+            {&resize_lanczos_float32_prefilter1,
+             &resize_lanczos_float32_prefilter2,
+             &resize_lanczos_float32_prefilter3}};
+
+    *levels = 0;
+    while (*levels < 3 && std::max(scale_x, scale_y) * (2 << *levels) <= 0.5f) {
+        (*levels)++;
+    }
+    if (*levels == 0 || output_type != "float32" || input_type != halide_type_of<uint8_t>()) {
+        return nullptr;
+    }
+    if (interpolation_type == "cubic") {
+        return multistage_variants[0][*levels - 1];
+    } else if (interpolation_type == "lanczos") {
+        return multistage_variants[1][*levels - 1];
+    }
+    return nullptr;
+}
+
+// Latency of resizing crops of in (8-bit) by scale_x, scale_y to
+// square outputs from 64 to 1024 pixels, with the generator's
+// small-output branch (up to small_size, 256) and with each of its two
+// schedules forced, to show where they cross over.
+void benchmark_latency_sizes(Halide::Runtime::Buffer<> in) {
+    printf("latency    size     default      serial    parallel\n");
+    const int order = resize_pass_order(interpolation_index("cubic"), scale_x, scale_y);
+    const ResizeFn variants[] = {&resize_cubic_uint8_float32,
+                                 &resize_cubic_uint8_float32_serial,
+                                 &resize_cubic_uint8_float32_parallel};
+    const char *variant_names[] = {"default", "serial", "parallel"};
+
+    for (int size : {64, 96, 128, 192, 256, 384, 512, 768, 1024}) {
+        int crop_width = (int)std::ceil(size / scale_x);
+        int crop_height = (int)std::ceil(size / scale_y);
+        if (crop_width > in.width() || crop_height > in.height()) {
+            break;
+        }
+        Halide::Runtime::Buffer<> crop = in.cropped(0, 0, crop_width).cropped(1, 0, crop_height);
+        Halide::Runtime::Buffer<float> out(size, size, 3);
+
+        HalideBench::Options opts = bench_options((double)size * size);
+        // Enough calls per sample for the smallest sizes to register
+        opts.iterations = std::max(benchmark_iters, (1 << 20) / (size * size));
+
+        printf("latency  %6d", size);
+        for (int v = 0; v < 3; v++) {
+            char name[96];
+            snprintf(name, sizeof(name), "resize/size_%s/cubic/float32/%gx%g/%d", variant_names[v], scale_x, scale_y, size);
+            HalideBench::Stats stats = HalideBench::benchmark(name, opts, [&]() { variants[v](crop, scale_x, scale_y, order, out); });
+            printf("  %7.1f us", stats.median * 1e6);
+        }
+        printf("\n");
+    }
+}
+
+// Time per output pixel of resizing crops of in (8-bit) by scale_x,
+// scale_y to output sizes that leave remainders after the 32 x 8 and
+// 16 x 64 tiles, and to one that doesn't, with the generator built for
+// each tail strategy. round_up computes an output padded to 32 x 64, of
+// which only the requested part counts. Every variant reads the same
+// crop, so their outputs must agree.
+void benchmark_tails(Halide::Runtime::Buffer<> in) {
+    const ResizeFn variants[] = {&resize_cubic_uint8_float32,
+                                 &resize_cubic_uint8_float32_tail_shift_inwards,
+                                 &resize_cubic_uint8_float32_tail_guard_with_if,
+                                 &resize_cubic_uint8_float32_tail_round_up,
+                                 &resize_cubic_uint8_float32_tail_epilogue};
+    const char *variant_names[] = {"auto", "shift_inwards", "guard_with_if", "round_up", "epilogue"};
+    const int round_up = 3;
+    const int sizes[][2] = {{997, 613}, {1366, 768}, {1921, 1081}, {1024, 768}};
+    const int order = resize_pass_order(interpolation_index("cubic"), scale_x, scale_y);
+
+    printf("tails        size");
+    for (const char *name : variant_names) {
+        printf("  %13s", name);
+    }
+    printf("   (ns per pixel)\n");
+
+    for (const auto &size : sizes) {
+        const int width = size[0], height = size[1];
+        const int padded_width = (width + 31) / 32 * 32, padded_height = (height + 63) / 64 * 64;
+        int crop_width = (int)std::ceil(padded_width / scale_x);
+        int crop_height = (int)std::ceil(padded_height / scale_y);
+        if (crop_width > in.width() || crop_height > in.height()) {
+            continue;
+        }
+        Halide::Runtime::Buffer<> crop = in.cropped(0, 0, crop_width).cropped(1, 0, crop_height);
+        Halide::Runtime::Buffer<float> reference;
+
+        HalideBench::Options opts = bench_options((double)width * height);
+
+        printf("tails  %5dx%-5d", width, height);
+        for (int v = 0; v < 5; v++) {
+            Halide::Runtime::Buffer<float> out(v == round_up ? padded_width : width,
+                                               v == round_up ? padded_height : height, 3);
+            char name[96];
+            snprintf(name, sizeof(name), "resize/tail_%s/cubic/float32/%gx%g/%dx%d", variant_names[v], scale_x, scale_y, width, height);
+            HalideBench::Stats stats = HalideBench::benchmark(name, opts, [&]() { variants[v](crop, scale_x, scale_y, order, out); });
+            printf("  %13.2f", stats.median * 1e9 / opts.pixels);
+
+            out.crop(0, 0, width).crop(1, 0, height);
+            if (!reference.data()) {
+                reference = out;
+            } else {
+                float max_error = 0;
+                out.for_each_element([&](int x, int y, int c) {
+                    max_error = std::max(max_error, std::abs(out(x, y, c) - reference(x, y, c)));
+                });
+                if (max_error > 1e-4f) {
+                    printf("\ntail strategy %s differs from auto by %g\n", variant_names[v], max_error);
+                    exit(1);
+                }
+            }
+        }
+        printf("\n");
+    }
+}
+
+// Decode-then-resize, the way this program treats its input, against
+// resize_extern_decode, which decodes the rows each strip of its output
+// needs with an extern stage, just before reading them. in is encoded
+// with the row codec first (row_codec.h). resize_predecoded is the same
+// algorithm and schedule as resize_extern_decode reading a decoded
+// image, so the two differ only in where the decoding happens.
+void benchmark_extern_decode(Halide::Runtime::Buffer<uint8_t> in) {
+    RowCodedImage image(in);
+    const int out_width = in.width() * scale_x, out_height = in.height() * scale_y;
+    Halide::Runtime::Buffer<float> out_cubic(out_width, out_height, in.channels());
+    Halide::Runtime::Buffer<float> out_predecoded(out_width, out_height, in.channels());
+    Halide::Runtime::Buffer<float> out_extern(out_width, out_height, in.channels());
+    const double out_pixels = (double)out_width * out_height;
+    const int order = resize_pass_order(interpolation_index("cubic"), scale_x, scale_y);
+
+    double decode_time = HalideBench::benchmark(bench_name("decode_rows"), bench_options((double)in.width() * in.height()), [&]() {
+                             image.decode();
+                         }).median;
+    double cubic_time = HalideBench::benchmark(bench_name("decode_then_resize"), bench_options(out_pixels), [&]() {
+                            resize_cubic_uint8_float32(image.decode(), scale_x, scale_y, order, out_cubic);
+                        }).median;
+    double predecoded_time = HalideBench::benchmark(bench_name("decode_then_strips"), bench_options(out_pixels), [&]() {
+                                 resize_predecoded(image.decode(), scale_x, scale_y, out_predecoded);
+                             }).median;
+
+    image.reset_rows_decoded();
+    int calls = 0;
+    double extern_time = HalideBench::benchmark(bench_name("extern_decode"), bench_options(out_pixels), [&]() {
+                             resize_extern_decode(&image, image.width(), image.height(), scale_x, scale_y, out_extern);
+                             calls++;
+                         }).median;
+    double rows_per_call = (double)image.rows_decoded() / std::max(calls, 1);
+
+    printf("decode  %dx%dx%d  decode alone: %f ms\n", in.width(), in.height(), in.channels(), decode_time * 1000);
+    printf("decode  then resize (cubic float32):  %f ms\n", cubic_time * 1000);
+    printf("decode  then strip resize:            %f ms\n", predecoded_time * 1000);
+    printf("decode  in strips (extern stage):     %f ms  (%1.2fx decode then strip resize, %1.2f rows decoded per image row)\n",
+           extern_time * 1000, predecoded_time / extern_time, rows_per_call / ((double)image.height() * image.channels()));
+
+    float max_error = 0;
+    out_extern.for_each_element([&](int x, int y, int c) {
+        max_error = std::max(max_error, std::abs(out_extern(x, y, c) - out_predecoded(x, y, c)));
+    });
+    if (max_error > 1e-5f) {
+        printf("decode  in strips differs from decode then strip resize by %g\n", max_error);
+        exit(1);
+    }
+}
+
+// Resizing 8-bit frames in memory we don't own, the way a capture
+// library hands them over. Each frame is resized in place through
+// wrap_frame, and then copied into a planar buffer first, which is what
+// this program does with the image load_image returns. The frames are
+// stored bottom-up with rows padded to a multiple of 256 bytes, once
+// interleaved and once planar.
+void benchmark_external_frames(Halide::Runtime::Buffer<uint8_t> in) {
+    const int out_width = in.width() * scale_x, out_height = in.height() * scale_y;
+    const double out_pixels = (double)out_width * out_height;
+    const int order = resize_pass_order(interpolation_index("cubic"), scale_x, scale_y);
+
+    for (bool interleaved : {true, false}) {
+        HalideSupport::FrameLayout layout;
+        layout.width = in.width();
+        layout.height = in.height();
+        layout.channels = in.channels();
+        layout.interleaved = interleaved;
+        layout.row_stride = ((interleaved ? in.width() * in.channels() : in.width()) + 255) / 256 * 256;
+        layout.bottom_up = true;
+        std::vector<uint8_t> memory(layout.row_stride * layout.height * (interleaved ? 1 : in.channels()));
+        Halide::Runtime::Buffer<uint8_t> frame = HalideSupport::wrap_frame<uint8_t>(memory.data(), layout);
+        if (!frame.defined()) {
+            fprintf(stderr, "Could not wrap the %s frame\n", interleaved ? "interleaved" : "planar");
+            exit(1);
+        }
+        frame.copy_from(in);
+
+        const char *layout_name = interleaved ? "interleaved" : "planar";
+        Halide::Runtime::Buffer<float> out_in_place(out_width, out_height, in.channels());
+        Halide::Runtime::Buffer<float> out_copied(out_width, out_height, in.channels());
+
+        double in_place_time = HalideBench::benchmark(bench_name((std::string("external_") + layout_name).c_str()), bench_options(out_pixels), [&]() {
+                                   resize_cubic_uint8_float32(frame, scale_x, scale_y, order, out_in_place);
+                               }).median;
+        double copied_time = HalideBench::benchmark(bench_name((std::string("copy_in_") + layout_name).c_str()), bench_options(out_pixels), [&]() {
+                                 Halide::Runtime::Buffer<uint8_t> planar(in.width(), in.height(), in.channels());
+                                 planar.copy_from(frame);
+                                 resize_cubic_uint8_float32(planar, scale_x, scale_y, order, out_copied);
+                             }).median;
+        printf("external  %11s bottom-up, row stride %d  in place: %f ms  copied in: %f ms  (%1.2fx)\n",
+               layout_name, (int)layout.row_stride, in_place_time * 1000, copied_time * 1000, copied_time / in_place_time);
+
+        float max_error = 0;
+        out_in_place.for_each_element([&](int x, int y, int c) {
+            max_error = std::max(max_error, std::abs(out_in_place(x, y, c) - out_copied(x, y, c)));
+        });
+        if (max_error > 1e-4f) {
+            printf("external  %s in place differs from copied in by %g\n", layout_name, max_error);
+            exit(1);
+        }
+    }
+}
+
 int main(int argc, char **argv) {
+    if (argc > 1 && std::string(argv[1]) == "--daemon") {
+        return run_daemon(argc > 2 ? argv[2] : nullptr);
+    }
     parse_commandline(argc, argv);
 
+    if (batch) {
+        return run_batch(infile, outfile, interpolation_type, output_type,
+                         scale_x, scale_y, queue_depth, codec_threads);
+    }
+
     Halide::Runtime::Buffer<> in = Halide::Tools::load_image(infile);
-    int out_width = in.width() * scale_factor;
-    int out_height = in.height() * scale_factor;
+    // The y pass walks down columns of the input, one TLB entry per row
+    // with 4 KiB pages. The outputs below come from huge_page_malloc,
+    // which gives ordinary memory unless huge pages were asked for.
+    if (huge_pages != HalideSupport::HugePages::Off) {
+        HalideSupport::use_huge_pages(huge_pages);
+        in = HalideSupport::copy_to_huge(in);
+    }
 
-    decltype(&resize_box_float32_up) variants[3][2][4] =
-        {
-            {{&resize_box_float32_up,
-              &resize_cubic_float32_up,
-              &resize_linear_float32_up,
-              &resize_lanczos_float32_up},
-             {&resize_box_float32_down,
-              &resize_cubic_float32_down,
-              &resize_linear_float32_down,
-              &resize_lanczos_float32_down}},
-            {{&resize_box_uint8_up,
-              &resize_cubic_uint8_up,
-              &resize_linear_uint8_up,
-              &resize_lanczos_uint8_up},
-             {&resize_box_uint8_down,
-              &resize_cubic_uint8_down,
-              &resize_linear_uint8_down,
-              &resize_lanczos_uint8_down}},
-            {{&resize_box_uint16_up,
-              &resize_cubic_uint16_up,
-              &resize_linear_uint16_up,
-              &resize_lanczos_uint16_up},
-             {&resize_box_uint16_down,
-              &resize_cubic_uint16_down,
-              &resize_linear_uint16_down,
-              &resize_lanczos_uint16_down}}};
-
-    int interpolation_idx = 0;
-    if (interpolation_type == "box") {
-        interpolation_idx = 0;
-    } else if (interpolation_type == "cubic") {
-        interpolation_idx = 1;
-    } else if (interpolation_type == "linear") {
-        interpolation_idx = 2;
-    } else if (interpolation_type == "lanczos") {
-        interpolation_idx = 3;
-    } else {
+    // Each node's share of the input rows is written by that node, the
+    // way its strips of the parallel loops will read them.
+    std::unique_ptr<HalideSupport::NumaPool> numa_pool;
+    if (numa_nodes > 0) {
+        numa_pool.reset(new HalideSupport::NumaPool(HalideSupport::numa_topology(numa_nodes)));
+        numa_pool->install();
+        Halide::Runtime::Buffer<> local(in.type(), nullptr, in.width(), in.height(), in.channels());
+        local.allocate(&HalideSupport::huge_page_malloc, &HalideSupport::huge_page_free);
+        HalideSupport::first_touch(*numa_pool, local, [&](Halide::Runtime::Buffer<> rows) {
+            rows.copy_from(in);
+        });
+        in = local;
+    }
+    int out_width = in.width() * scale_x;
+    int out_height = in.height() * scale_y;
+    const double out_pixels = (double)out_width * out_height;
+
+    int interpolation_idx = interpolation_index(interpolation_type);
+    if (interpolation_idx < 0) {
         fprintf(stderr, "Unknown interpolation type: %s\n", interpolation_type.c_str());
         show_usage_and_exit();
     }
 
-    int upsample_idx = scale_factor > 1.0f ? 0 : 1;
-
-    // Instead of just adapting to the actual type of the input, we'll
-    // convert it to the requested type to make it easier to benchmark
-    // lots of different types.
-    int type_idx = 0;
-    if (input_type == "float32") {
-        in = Halide::Tools::ImageTypeConversion::convert_image(in, halide_type_of<float>());
-        type_idx = 0;
-    } else if (input_type == "uint8") {
-        in = Halide::Tools::ImageTypeConversion::convert_image(in, halide_type_of<uint8_t>());
-        type_idx = 1;
-    } else if (input_type == "uint16") {
-        in = Halide::Tools::ImageTypeConversion::convert_image(in, halide_type_of<uint16_t>());
-        type_idx = 2;
-    } else {
-        fprintf(stderr, "Unhandled type: %s\n", input_type.c_str());
+    // Run the cheaper order of the x and y passes for the two ratios
+    // unless told otherwise.
+    int order = resize_pass_order(interpolation_idx, scale_x, scale_y);
+    if (pass_order == "x") {
+        order = 1;
+    } else if (pass_order == "y") {
+        order = 2;
+    } else if (pass_order != "auto" && pass_order != "compare") {
+        fprintf(stderr, "Unknown pass order: %s\n", pass_order.c_str());
+        show_usage_and_exit();
+    }
+
+    // The pipeline reads the image in whatever type it decoded to and
+    // writes the requested type, converting as it goes, so there's no
+    // separate conversion pass over the input.
+    int type_idx = type_index(output_type);
+    if (type_idx < 0) {
+        fprintf(stderr, "Unhandled type: %s\n", output_type.c_str());
         show_usage_and_exit();
     }
 
-    Halide::Runtime::Buffer<> out(in.type(), out_width, out_height, 3);
+    Halide::Runtime::Buffer<> out = HalideSupport::allocate_huge(type_of_index(type_idx), out_width, out_height, 3);
 
-    auto resize_fn = variants[type_idx][upsample_idx][interpolation_idx];
+    auto resize_fn = find_resize_variant(in.type(), type_idx, interpolation_idx);
+    if (!resize_fn) {
+        fprintf(stderr, "No resize variant reads %d-bit %s images\n",
+                in.type().bits, in.type().is_float() ? "float" : "integer");
+        return 1;
+    }
 
-    double time = Halide::Tools::benchmark(benchmark_iters, benchmark_iters, [&]() { resize_fn(in, scale_factor, out); });
-    printf("planar  %8s  %8s  %1.2f  time: %f ms\n",
-           interpolation_type.c_str(), input_type.c_str(), scale_factor, time * 1000);
+    HalideBench::Stats planar_stats = HalideBench::benchmark(bench_name("planar"), bench_options(out_pixels), [&]() { resize_fn(in, scale_x, scale_y, order, out); });
+    double planar_time = planar_stats.median;
+    double time = planar_time;
+    printf("planar  %8s  %8s  %1.2fx%1.2f  time: %f ms  (%s)\n",
+           interpolation_type.c_str(), output_type.c_str(), scale_x, scale_y, time * 1000,
+           planar_stats.summary().c_str());
+    if (huge_pages != HalideSupport::HugePages::Off) {
+        long long backed = HalideSupport::huge_page_bytes_backed();
+        printf("huge pages (%s): %.1f MB asked for, %.1f MB backed\n",
+               HalideSupport::huge_pages_name(huge_pages),
+               HalideSupport::huge_page_bytes_requested() / 1e6, backed < 0 ? 0.0 : backed / 1e6);
+    }
+    if (numa_pool) {
+        // The first parallel loop of a run is the one reading the input.
+        numa_pool->clear_history();
+        resize_fn(in, scale_x, scale_y, order, out);
+        std::vector<std::vector<int>> loops = numa_pool->history();
+        double local = loops.empty() ? 0 : HalideSupport::node_local_ratio(loops[0], HalideSupport::row_home_nodes(numa_pool->topology(), in));
+        printf("numa    %d %snodes, %.0f%% of input rows read node-local\n",
+               (int)numa_pool->topology().nodes.size(), numa_pool->topology().simulated ? "simulated " : "", local * 100);
+    }
 
-    Halide::Tools::convert_and_save_image(out, outfile);
+    if (pass_order == "compare") {
+        const char *names[] = {"x first", "y first"};
+        for (int forced = 1; forced <= 2; forced++) {
+            Halide::Runtime::Buffer<> out_forced = HalideSupport::allocate_huge(out.type(), out_width, out_height, 3);
+            time = HalideBench::benchmark(bench_name(forced == 1 ? "x_first" : "y_first"), bench_options(out_pixels), [&]() { resize_fn(in, scale_x, scale_y, forced, out_forced); }).median;
+            printf("order   %8s  %8s  %1.2fx%1.2f  %s: %f ms  (%1.2fx auto)\n",
+                   interpolation_type.c_str(), output_type.c_str(), scale_x, scale_y,
+                   names[forced - 1], time * 1000, time / planar_time);
+        }
+    }
+
+    if (half_intermediates) {
+        if (output_type == "float32" && in.type() == halide_type_of<uint8_t>()) {
+            decltype(&resize_box_float32_f16) half_variants[4] =
+                {&resize_box_float32_f16,
+                 &resize_cubic_float32_f16,
+                 &resize_linear_float32_f16,
+                 &resize_lanczos_float32_f16};
+            auto half_fn = half_variants[interpolation_idx];
+
+            Halide::Runtime::Buffer<> out_half = HalideSupport::allocate_huge(out.type(), out_width, out_height, 3);
+            double half_time = HalideBench::benchmark(bench_name("half"), bench_options(out_pixels), [&]() { half_fn(in, scale_x, scale_y, order, out_half); }).median;
+            ImageError error = compare_images(out_half, out);
+            double megapixels = (double)in.width() * in.height() / 1e6;
+            printf("half    %8s  %8s  %1.2fx%1.2f  time: %f ms  (%1.2fx faster, %.1f vs %.1f input MP/s)\n"
+                   "        error vs float32: max %g  rms %g  PSNR %.2f dB\n",
+                   interpolation_type.c_str(), output_type.c_str(), scale_x, scale_y, half_time * 1000,
+                   planar_time / half_time, megapixels / half_time, megapixels / planar_time,
+                   error.max_abs, error.rms, error.psnr);
+        } else {
+            printf("half    %8s  %8s  only compiled for uint8 to float32, skipping\n",
+                   interpolation_type.c_str(), output_type.c_str());
+        }
+    }
+
+    ImageConvert::convert_and_save_image(out, outfile);
+
+    if (multistage) {
+        int levels;
+        auto multistage_fn = pick_multistage(in.type(), &levels);
+        if (multistage_fn) {
+            // What's left after the prefilter may want the other order.
+            int multistage_order = pass_order == "x" || pass_order == "y" ? order : resize_pass_order(interpolation_idx, scale_x, scale_y, levels);
+            Halide::Runtime::Buffer<> out_multistage = HalideSupport::allocate_huge(out.type(), out_width, out_height, 3);
+            double multistage_time = HalideBench::benchmark(bench_name("multistage"), bench_options(out_pixels), [&]() { multistage_fn(in, scale_x, scale_y, multistage_order, out_multistage); }).median;
+            printf("multi   %8s  %8s  %1.2fx%1.2f  time: %f ms  (%d x 2x box, %1.2fx faster, PSNR vs single-stage: %.2f dB)\n",
+                   interpolation_type.c_str(), output_type.c_str(), scale_x, scale_y, multistage_time * 1000,
+                   levels, planar_time / multistage_time, compare_images(out_multistage, out).psnr);
+            ImageConvert::convert_and_save_image(out_multistage, with_suffix(outfile, "_multistage"));
+        } else {
+            printf("multi   %8s  %8s  %1.2fx%1.2f  no multi-stage variant, skipping\n",
+                   interpolation_type.c_str(), output_type.c_str(), scale_x, scale_y);
+        }
+    }
+
+    if (kernel_setup) {
+        benchmark_kernel_setup(out_width);
+    }
+
+    if (latency_sizes) {
+        if (in.type() == halide_type_of<uint8_t>()) {
+            benchmark_latency_sizes(in);
+        } else {
+            printf("latency  only compiled for 8-bit input, skipping\n");
+        }
+    }
+
+    if (tails) {
+        if (in.type() == halide_type_of<uint8_t>()) {
+            benchmark_tails(in);
+        } else {
+            printf("tails  only compiled for 8-bit input, skipping\n");
+        }
+    }
+
+    if (extern_decode) {
+        if (in.type() == halide_type_of<uint8_t>()) {
+            benchmark_extern_decode(in);
+        } else {
+            printf("decode  only compiled for 8-bit input, skipping\n");
+        }
+    }
+
+    if (external_frames) {
+        if (in.type() == halide_type_of<uint8_t>()) {
+            benchmark_external_frames(in);
+        } else {
+            printf("external  only compiled for 8-bit input, skipping\n");
+        }
+    }
 
     if (packed) {
-        // Also benchmark a packed memory layout. Don't bother to copy the
-        // actual data over, because we won't save the result. We just
-        // want to measure the runtime.
+        // Also benchmark a packed memory layout, on the same image
+        // converted to it, and time the conversions in and out so the
+        // packed path can be costed end to end.
         auto in_packed =
             Halide::Runtime::Buffer<>::make_interleaved(in.type(), in.width(), in.height(), in.channels());
         auto out_packed =
             Halide::Runtime::Buffer<>::make_interleaved(out.type(), out.width(), out.height(), out.channels());
-        time = Halide::Tools::benchmark(benchmark_iters, benchmark_iters, [&]() { resize_fn(in_packed, scale_factor, out_packed); });
-        printf("packed  %8s  %8s  %1.2f  time: %f ms\n",
-               interpolation_type.c_str(), input_type.c_str(), scale_factor, time * 1000);
+        Halide::Runtime::Buffer<> out_unpacked(out.type(), out.width(), out.height(), out.channels());
+
+        double to_packed_time = HalideBench::benchmark(bench_name("to_packed"), bench_options((double)in.width() * in.height()), [&]() { ImageConvert::convert_layout_into(in, in_packed); }).median;
+        time = HalideBench::benchmark(bench_name("packed"), bench_options(out_pixels), [&]() { resize_fn(in_packed, scale_x, scale_y, order, out_packed); }).median;
+        double to_planar_time = HalideBench::benchmark(bench_name("to_planar"), bench_options(out_pixels), [&]() { ImageConvert::convert_layout_into(out_packed, out_unpacked); }).median;
+        printf("packed  %8s  %8s  %1.2fx%1.2f  time: %f ms  (%1.2fx planar)  to packed: %f ms  to planar: %f ms\n",
+               interpolation_type.c_str(), output_type.c_str(), scale_x, scale_y, time * 1000, time / planar_time,
+               to_packed_time * 1000, to_planar_time * 1000);
     }
 
     printf("Success!\n");
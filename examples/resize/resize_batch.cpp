@@ -0,0 +1,267 @@
+#include "resize_batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "HalideBuffer.h"
+#include "halide_image_io.h"
+
+#include "convert_image.h"
+#include "resize_variants.h"
+
+using Halide::Runtime::Buffer;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct BatchJob {
+    int index;
+    std::string infile, outfile;
+    Buffer<> image;
+};
+
+// Blocks producers while full and consumers while empty. Once closed,
+// pop() drains what is left and then returns false.
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(int capacity)
+        : capacity(capacity) {
+    }
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [&]() { return (int)items.size() < capacity; });
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+    }
+
+    bool pop(T *item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [&]() { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        *item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+private:
+    int capacity;
+    bool closed = false;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable not_full, not_empty;
+};
+
+// Seconds spent working, summed over all the threads of a stage.
+class StageTimer {
+public:
+    void add(Clock::time_point start) {
+        double s = seconds_since(start);
+        std::lock_guard<std::mutex> lock(mutex);
+        busy += s;
+    }
+
+    double busy_fraction(double wall, int threads) const {
+        return wall > 0 ? busy / (wall * threads) : 0;
+    }
+
+    double busy = 0;
+
+private:
+    std::mutex mutex;
+};
+
+struct BatchTimers {
+    StageTimer decode, resize, encode;
+};
+
+class Batch {
+public:
+    Batch(int type_idx, int interpolation_idx, float scale_x, float scale_y)
+        : type_idx(type_idx), interpolation_idx(interpolation_idx), scale_x(scale_x), scale_y(scale_y) {
+    }
+
+    void decode(BatchJob &job, BatchTimers &timers) {
+        Clock::time_point start = Clock::now();
+        job.image = Halide::Tools::load_image(job.infile);
+        timers.decode.add(start);
+    }
+
+    // The resize reads the image as decoded and writes the requested
+    // type directly; only float results need converting when encoded.
+    bool resize(BatchJob &job, BatchTimers &timers) {
+        Clock::time_point start = Clock::now();
+        ResizeFn resize_fn = find_resize_variant(job.image.type(), type_idx, interpolation_idx);
+        if (!resize_fn) {
+            fprintf(stderr, "No resize variant reads the type %s decodes to\n", job.infile.c_str());
+            return false;
+        }
+        Buffer<> out(type_of_index(type_idx), std::max(1, (int)(job.image.width() * scale_x)),
+                     std::max(1, (int)(job.image.height() * scale_y)), job.image.channels());
+        int result = resize_fn(job.image, scale_x, scale_y, resize_pass_order(interpolation_idx, scale_x, scale_y), out);
+        job.image = out;
+        timers.resize.add(start);
+        if (result != 0) {
+            fprintf(stderr, "Resizing %s failed with error %d\n", job.infile.c_str(), result);
+        }
+        return result == 0;
+    }
+
+    void encode(BatchJob &job, BatchTimers &timers) {
+        Clock::time_point start = Clock::now();
+        ImageConvert::convert_and_save_image(job.image, job.outfile);
+        job.image = Buffer<>();
+        timers.encode.add(start);
+    }
+
+    bool run_serial(std::vector<BatchJob> jobs, BatchTimers &timers) {
+        bool ok = true;
+        for (BatchJob &job : jobs) {
+            decode(job, timers);
+            if (resize(job, timers)) {
+                encode(job, timers);
+            } else {
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    bool run_pipelined(const std::vector<BatchJob> &jobs, BatchTimers &timers,
+                       int queue_depth, int codec_threads) {
+        BoundedQueue<BatchJob> decoded(queue_depth), resized(queue_depth);
+        std::atomic<int> next_job{0}, decoders_left{codec_threads};
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < codec_threads; i++) {
+            threads.emplace_back([&]() {
+                int j;
+                while ((j = next_job++) < (int)jobs.size()) {
+                    BatchJob job = jobs[j];
+                    decode(job, timers);
+                    decoded.push(std::move(job));
+                }
+                if (--decoders_left == 0) {
+                    decoded.close();
+                }
+            });
+            threads.emplace_back([&]() {
+                BatchJob job;
+                while (resized.pop(&job)) {
+                    encode(job, timers);
+                }
+            });
+        }
+
+        // Halide already spreads each resize over the thread pool, so a
+        // single thread feeds it.
+        bool ok = true;
+        BatchJob job;
+        while (decoded.pop(&job)) {
+            if (resize(job, timers)) {
+                resized.push(std::move(job));
+            } else {
+                ok = false;
+            }
+        }
+        resized.close();
+
+        for (std::thread &t : threads) {
+            t.join();
+        }
+        return ok;
+    }
+
+private:
+    int type_idx, interpolation_idx;
+    float scale_x, scale_y;
+};
+
+std::string base_name(const std::string &path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+}  // namespace
+
+int run_batch(const std::string &list_file, const std::string &out_dir,
+              const std::string &interpolation_type, const std::string &type,
+              float scale_x, float scale_y, int queue_depth, int codec_threads) {
+    int type_idx = type_index(type);
+    int interpolation_idx = interpolation_index(interpolation_type);
+    if (type_idx < 0 || interpolation_idx < 0) {
+        fprintf(stderr, "Unknown variant: %s %s\n", interpolation_type.c_str(), type.c_str());
+        return 1;
+    }
+
+    std::vector<BatchJob> jobs;
+    std::ifstream list(list_file);
+    std::string line;
+    while (std::getline(list, line)) {
+        if (!line.empty()) {
+            int index = (int)jobs.size();
+            jobs.push_back({index, line, out_dir + "/" + std::to_string(index) + "_" + base_name(line), Buffer<>()});
+        }
+    }
+    if (jobs.empty()) {
+        fprintf(stderr, "No input files listed in %s\n", list_file.c_str());
+        return 1;
+    }
+
+    Batch batch(type_idx, interpolation_idx, scale_x, scale_y);
+
+    BatchTimers serial_timers;
+    Clock::time_point start = Clock::now();
+    bool ok = batch.run_serial(jobs, serial_timers);
+    double serial_time = seconds_since(start);
+
+    BatchTimers pipelined_timers;
+    start = Clock::now();
+    ok = batch.run_pipelined(jobs, pipelined_timers, queue_depth, codec_threads) && ok;
+    double pipelined_time = seconds_since(start);
+
+    int n = (int)jobs.size();
+    printf("serial     %3d images  %8s  %8s  time: %f ms  %.1f images/s  "
+           "(decode %.0f%%, resize %.0f%%, encode %.0f%% of the time)\n",
+           n, interpolation_type.c_str(), type.c_str(), serial_time * 1000, n / serial_time,
+           100 * serial_timers.decode.busy_fraction(serial_time, 1),
+           100 * serial_timers.resize.busy_fraction(serial_time, 1),
+           100 * serial_timers.encode.busy_fraction(serial_time, 1));
+    printf("pipelined  %3d images  %8s  %8s  time: %f ms  %.1f images/s  (%1.2fx serial)\n"
+           "           busy: decode %.0f%% of %d threads, resize %.0f%%, encode %.0f%% of %d threads, queue depth %d\n",
+           n, interpolation_type.c_str(), type.c_str(), pipelined_time * 1000, n / pipelined_time,
+           serial_time / pipelined_time,
+           100 * pipelined_timers.decode.busy_fraction(pipelined_time, codec_threads), codec_threads,
+           100 * pipelined_timers.resize.busy_fraction(pipelined_time, 1),
+           100 * pipelined_timers.encode.busy_fraction(pipelined_time, codec_threads), codec_threads,
+           queue_depth);
+
+    if (!ok) {
+        return 1;
+    }
+    printf("Success!\n");
+    return 0;
+}
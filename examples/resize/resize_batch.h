@@ -0,0 +1,20 @@
+#ifndef RESIZE_BATCH_H
+#define RESIZE_BATCH_H
+
+#include <string>
+
+// Batch mode of the resize example. Every line of list_file names an
+// input image, and the result is written to out_dir as
+// <line number>_<file name>. Files flow through three stages joined by
+// queues of at most queue_depth images: codec_threads threads decoding,
+// one thread calling the (already parallel) Halide pipeline, and
+// codec_threads threads encoding, so the codec work of neighbouring
+// images overlaps the resize of the current one.
+//
+// The list is run once one file at a time and once pipelined, and both
+// throughputs are printed along with how busy each stage was.
+int run_batch(const std::string &list_file, const std::string &out_dir,
+              const std::string &interpolation_type, const std::string &type,
+              float scale_x, float scale_y, int queue_depth, int codec_threads);
+
+#endif  // RESIZE_BATCH_H
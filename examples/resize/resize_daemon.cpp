@@ -0,0 +1,343 @@
+#include "resize_daemon.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "HalideBuffer.h"
+#include "halide_image_io.h"
+
+#include "convert_image.h"
+#include "resize_variants.h"
+
+using Halide::Runtime::Buffer;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Buffers handed out by type and shape and given back after each job,
+// so that a stream of same-sized images stops allocating after the
+// first one.
+class BufferPool {
+public:
+    Buffer<> acquire(halide_type_t type, int width, int height, int channels) {
+        Key key(type.code, type.bits, width, height, channels);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<Buffer<>> &free = free_buffers[key];
+            if (!free.empty()) {
+                Buffer<> buf = std::move(free.back());
+                free.pop_back();
+                return buf;
+            }
+            allocations++;
+        }
+        return Buffer<>(type, width, height, channels);
+    }
+
+    void release(Buffer<> buf) {
+        Key key(buf.type().code, buf.type().bits, buf.width(), buf.height(), buf.channels());
+        std::lock_guard<std::mutex> lock(mutex);
+        free_buffers[key].push_back(std::move(buf));
+    }
+
+    int allocation_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return allocations;
+    }
+
+private:
+    typedef std::tuple<int, int, int, int, int> Key;
+    std::mutex mutex;
+    std::map<Key, std::vector<Buffer<>>> free_buffers;
+    int allocations = 0;
+};
+
+class JobStats {
+public:
+    void record(Clock::time_point start, bool ok) {
+        Clock::time_point end = Clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (latencies_ms.empty() && failures == 0) {
+            first_start = start;
+        }
+        last_end = end;
+        if (ok) {
+            latencies_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        } else {
+            failures++;
+        }
+    }
+
+    std::string report() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<double> sorted = latencies_ms;
+        std::sort(sorted.begin(), sorted.end());
+        double seconds = std::chrono::duration<double>(last_end - first_start).count();
+        char line[256];
+        snprintf(line, sizeof(line), "jobs: %d  failed: %d  p50: %.3f ms  p99: %.3f ms  throughput: %.1f jobs/s",
+                 (int)sorted.size(), failures, percentile(sorted, 0.50), percentile(sorted, 0.99),
+                 seconds > 0 ? sorted.size() / seconds : 0.0);
+        return line;
+    }
+
+    int failure_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return failures;
+    }
+
+private:
+    static double percentile(const std::vector<double> &sorted, double p) {
+        if (sorted.empty()) {
+            return 0;
+        }
+        size_t idx = (size_t)std::ceil(p * sorted.size());
+        return sorted[std::min(sorted.size(), std::max<size_t>(idx, 1)) - 1];
+    }
+
+    std::mutex mutex;
+    std::vector<double> latencies_ms;
+    int failures = 0;
+    Clock::time_point first_start, last_end;
+};
+
+class Daemon {
+public:
+    // Run one small resize so the Halide thread pool is up and the
+    // variant code is paged in before the first real job.
+    void warm_up() {
+        Buffer<uint8_t> in(64, 64, 3);
+        Buffer<float> out(32, 32, 3);
+        in.fill(128);
+        const int cubic = interpolation_index("cubic");
+        find_resize_variant(in.type(), type_index("float32"), cubic)(in, 0.5f, 0.5f, resize_pass_order(cubic, 0.5f, 0.5f), out);
+    }
+
+    // Handle one request line and return the reply line.
+    std::string handle(const std::string &line) {
+        Clock::time_point start = Clock::now();
+        std::istringstream fields(line);
+        std::string command;
+        fields >> command;
+        if (command == "stats") {
+            return stats.report() + "  buffers allocated: " + std::to_string(pool.allocation_count());
+        } else if (command == "quit") {
+            stopping = true;
+            return "ok";
+        }
+
+        std::string infile = command, outfile, interpolation_type, type;
+        float scale_x = 0, scale_y = 0;
+        if (!(fields >> outfile >> interpolation_type >> type >> scale_x >> scale_y) ||
+            scale_x <= 0 || scale_y <= 0) {
+            stats.record(start, false);
+            return "error expected: in.png out.png interpolation type scale_x scale_y";
+        }
+
+        std::string error = run_job(infile, outfile, interpolation_type, type, scale_x, scale_y);
+        stats.record(start, error.empty());
+        if (!error.empty()) {
+            return "error " + error;
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        return "ok " + std::to_string(ms);
+    }
+
+    std::string run_job(const std::string &infile, const std::string &outfile,
+                        const std::string &interpolation_type, const std::string &type,
+                        float scale_x, float scale_y) {
+        int type_idx = type_index(type);
+        int interpolation_idx = interpolation_index(interpolation_type);
+        if (type_idx < 0 || interpolation_idx < 0) {
+            return "unknown variant " + interpolation_type + " " + type;
+        }
+
+        // The decoder allocates its own buffer; everything after it
+        // comes from the pool.
+        Buffer<> decoded;
+        if (!Halide::Tools::load(infile, &decoded)) {
+            return "could not load " + infile;
+        }
+        if (decoded.dimensions() == 2) {
+            decoded.embed(2, 0);
+        }
+
+        // The resize reads the decoded image directly and converts to
+        // the requested type as it goes.
+        ResizeFn resize_fn = find_resize_variant(decoded.type(), type_idx, interpolation_idx);
+        if (!resize_fn) {
+            return "no variant reads the type " + infile + " decodes to";
+        }
+
+        int out_width = std::max(1, (int)(decoded.width() * scale_x));
+        int out_height = std::max(1, (int)(decoded.height() * scale_y));
+        Buffer<> out = pool.acquire(type_of_index(type_idx), out_width, out_height, decoded.channels());
+
+        int result = resize_fn(decoded, scale_x, scale_y, resize_pass_order(interpolation_idx, scale_x, scale_y), out);
+
+        // PNG has no float pixels, so float results are written with the
+        // bit depth the input had.
+        Buffer<> encoded = out;
+        int converted = 0;
+        if (result == 0 && out.type().code == halide_type_float) {
+            encoded = pool.acquire(decoded.type(), out_width, out_height, decoded.channels());
+            converted = ImageConvert::convert_image_into(out, encoded);
+        }
+        bool saved = result == 0 && converted == 0 && Halide::Tools::save(encoded, outfile);
+
+        if (encoded.data() != out.data()) {
+            pool.release(encoded);
+        }
+        pool.release(out);
+
+        if (result != 0) {
+            return "resize failed with error " + std::to_string(result);
+        } else if (converted != 0) {
+            return "converting to the input's type failed with error " + std::to_string(converted);
+        } else if (!saved) {
+            return "could not save " + outfile;
+        }
+        return "";
+    }
+
+    void serve_stdin() {
+        std::string line;
+        while (!stopping && std::getline(std::cin, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            std::cout << handle(line) << std::endl;
+        }
+    }
+
+    bool serve_socket(const char *path) {
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+        unlink(path);
+        if (listener < 0 ||
+            bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+            listen(listener, 16) != 0) {
+            fprintf(stderr, "Could not listen on %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        listen_fd = listener;
+        printf("Listening on %s\n", path);
+        fflush(stdout);
+
+        // Each connection runs on its own detached thread, which is gone
+        // once its fd has left live_fds.
+        while (!stopping) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0) {
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(connections_mutex);
+                live_fds.insert(fd);
+            }
+            std::thread([this, fd]() { serve_connection(fd); }).detach();
+        }
+
+        // Other clients may be idle, with their threads blocked in
+        // read(); shutting their sockets down makes it return.
+        {
+            std::unique_lock<std::mutex> lock(connections_mutex);
+            for (int fd : live_fds) {
+                shutdown(fd, SHUT_RDWR);
+            }
+            connections_done.wait(lock, [this]() { return live_fds.empty(); });
+        }
+        close(listener);
+        unlink(path);
+        return true;
+    }
+
+    void serve_connection(int fd) {
+        std::string pending;
+        char chunk[4096];
+        ssize_t n;
+        while (!stopping && (n = read(fd, chunk, sizeof(chunk))) > 0) {
+            pending.append(chunk, n);
+            size_t newline;
+            while ((newline = pending.find('\n')) != std::string::npos) {
+                std::string line = pending.substr(0, newline);
+                pending.erase(0, newline + 1);
+                if (line.empty()) {
+                    continue;
+                }
+                std::string reply = handle(line) + "\n";
+                if (write(fd, reply.data(), reply.size()) < 0) {
+                    break;
+                }
+                if (stopping) {
+                    // Wake up the accept() in serve_socket.
+                    shutdown(listen_fd, SHUT_RDWR);
+                    break;
+                }
+            }
+        }
+
+        // The fd is closed under the lock so serve_socket can't shut
+        // down another connection that reuses the number. The
+        // notification waits for this thread to exit, after which
+        // serve_socket may return and destroy the daemon.
+        std::unique_lock<std::mutex> lock(connections_mutex);
+        live_fds.erase(fd);
+        close(fd);
+        std::notify_all_at_thread_exit(connections_done, std::move(lock));
+    }
+
+    JobStats stats;
+
+private:
+    BufferPool pool;
+    std::atomic<bool> stopping{false};
+    int listen_fd = -1;
+    std::mutex connections_mutex;
+    std::condition_variable connections_done;
+    // The sockets of the connections still being served
+    std::set<int> live_fds;
+};
+
+}  // namespace
+
+int run_daemon(const char *socket_path) {
+    Daemon daemon;
+    daemon.warm_up();
+
+    if (socket_path) {
+        if (!daemon.serve_socket(socket_path)) {
+            return 1;
+        }
+    } else {
+        daemon.serve_stdin();
+    }
+
+    printf("%s\n", daemon.stats.report().c_str());
+    if (daemon.stats.failure_count() == 0) {
+        printf("Success!\n");
+    }
+    return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef RESIZE_DAEMON_H
+#define RESIZE_DAEMON_H
+
+// Long-running mode of the resize example. Jobs arrive one per line,
+//
+//     in.png out.png box|linear|cubic|lanczos float32|uint8|uint16 scale_x scale_y
+//
+// either on stdin (socket_path == nullptr) or over a Unix domain socket
+// at socket_path, and each gets a one-line reply, "ok <ms>" or
+// "error <reason>". "stats" replies with the latency percentiles and
+// throughput so far, and "quit" stops the daemon, which then prints
+// the same statistics to stdout. Quitting over the socket disconnects
+// any other clients still connected.
+//
+// The type is that of the resize output; the input is read as it
+// decodes. The Halide thread pool is warmed up before the first job,
+// and the buffers the pipeline writes are pooled by shape and type, so
+// steady-state jobs only pay for PNG decode/encode and the resize.
+int run_daemon(const char *socket_path);
+
+#endif  // RESIZE_DAEMON_H
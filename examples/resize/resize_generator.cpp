@@ -1,80 +1,93 @@
 #include "Halide.h"
 
+#include "resize_kernels.h"
+#include "value_range.h"
+
 using namespace Halide;
 
-enum InterpolationType {
-    Box,
-    Linear,
-    Cubic,
-    Lanczos
+enum IntermediateType {
+    Float32,
+    Float16,
+    BFloat16
 };
 
-Expr kernel_box(Expr x) {
-    Expr xx = abs(x);
-    return select(xx <= 0.5f, 1.0f, 0.0f);
-}
-
-Expr kernel_linear(Expr x) {
-    Expr xx = abs(x);
-    return select(xx < 1.0f, 1.0f - xx, 0.0f);
-}
-
-Expr kernel_cubic(Expr x) {
-    Expr xx = abs(x);
-    Expr xx2 = xx * xx;
-    Expr xx3 = xx2 * xx;
-    float a = -0.5f;
-
-    return select(xx < 1.0f, (a + 2.0f) * xx3 - (a + 3.0f) * xx2 + 1,
-                  select(xx < 2.0f, a * xx3 - 5 * a * xx2 + 8 * a * xx - 4.0f * a,
-                         0.0f));
-}
-
-Expr sinc(Expr x) {
-    x *= 3.14159265359f;
-    return sin(x) / x;
-}
-
-Expr kernel_lanczos(Expr x) {
-    Expr value = sinc(x) * sinc(x / 3);
-    value = select(x == 0.0f, 1.0f, value);        // Take care of singularity at zero
-    value = select(x > 3 || x < -3, 0.0f, value);  // Clamp to zero out of bounds
-    return value;
-}
-
-struct KernelInfo {
-    const char *name;
-    int taps;
-    Expr (*kernel)(Expr);
+// How the output tiles and the vectorized intermediates handle
+// extents that aren't a multiple of their size. Epilogue runs whole
+// tiles with no tail code when the output is a multiple of all of them
+// (32 x 64), and guards the remainder with scalar code otherwise.
+enum class ResizeTail {
+    Auto,
+    ShiftInwards,
+    GuardWithIf,
+    RoundUp,  // The caller pads the output to 32 x 64.
+    Epilogue
 };
 
-static KernelInfo kernel_info[] = {
-    {"box", 1, kernel_box},
-    {"linear", 2, kernel_linear},
-    {"cubic", 4, kernel_cubic},
-    {"lanczos", 6, kernel_lanczos}};
+// Which resampling pass runs first: chosen per call through the
+// pass_order argument, or built in.
+enum class PassOrder {
+    Runtime,
+    XFirst,
+    YFirst
+};
 
 class Resize : public Halide::Generator<Resize> {
 public:
     GeneratorParam<InterpolationType> interpolation_type{"interpolation_type", Cubic, {{"box", Box}, {"linear", Linear}, {"cubic", Cubic}, {"lanczos", Lanczos}}};
 
-    // If we statically know whether we're upsampling or downsampling,
-    // we can generate different pipelines (we want to reorder the
-    // resample in x and in y).
-    GeneratorParam<bool> upsample{"upsample", false};
+    // Evaluate cubic and lanczos from a table computed once per call
+    // (see lookup_kernel) rather than in closed form for every tap.
+    GeneratorParam<bool> fast_kernel{"fast_kernel", true};
+
+    // For large reductions, first halve the input this many times with
+    // an exact 2x2 box filter, and only run the (much narrower)
+    // interpolation kernel over what remains. scale_x and scale_y are
+    // still the overall ratios.
+    GeneratorParam<int> prefilter_levels{"prefilter_levels", 0};
+
+    // Storage type of the output of the first resampling pass. The
+    // arithmetic is always float32, but 16-bit storage halves the
+    // bytes moved through cache between the two passes. float16 keeps
+    // 11 bits of mantissa, bfloat16 8; float16 falls back to bfloat16
+    // on x86 without F16C, where converting it is slow.
+    GeneratorParam<IntermediateType> intermediate_type{"intermediate_type", Float32, {{"float32", Float32}, {"float16", Float16}, {"bfloat16", BFloat16}}};
+
+    // Outputs at most this big in both dimensions run serially, one
+    // tile of native vectors at a time, where the parallel schedule's
+    // task dispatch and wide tiles cost more than the work. 0 turns it
+    // off.
+    GeneratorParam<int> small_size{"small_size", 256};
+
+    GeneratorParam<ResizeTail> tail{"tail", ResizeTail::Auto, {{"auto", ResizeTail::Auto}, {"shift_inwards", ResizeTail::ShiftInwards}, {"guard_with_if", ResizeTail::GuardWithIf}, {"round_up", ResizeTail::RoundUp}, {"epilogue", ResizeTail::Epilogue}}};
+
+    // x or y builds that pass order in and ignores pass_order, for
+    // schedules that can't specialize on it, such as the
+    // auto-schedulers'.
+    GeneratorParam<PassOrder> pass_order_fixed{"pass_order_fixed", PassOrder::Runtime, {{"runtime", PassOrder::Runtime}, {"x", PassOrder::XFirst}, {"y", PassOrder::YFirst}}};
 
     Input<Buffer<>> input{"input", 3};
-    Input<float> scale_factor{"scale_factor"};
+    Input<float> scale_x{"scale_x"};
+    Input<float> scale_y{"scale_y"};
+    // 1 runs the x resampling pass first, 2 the y pass; anything else
+    // is an error. Pick it with resize_pass_order() (resize_variants.h).
+    // The schedule specializes on this bare parameter, which
+    // substitutes it into the definition, so each branch realizes only
+    // its own order's intermediates.
+    Input<int> pass_order{"pass_order"};
     Output<Buffer<>> output{"output", 3};
 
     // Common Vars
-    Var x, y, c, k;
+    Var x, y, c, k, xi, yi;
 
-    // Intermediate Funcs
-    Func as_float, clamped, resized_x, resized_y,
+    // Intermediate Funcs. The resize can run the x pass first
+    // (resized_x_first, then resized_xy) or the y pass first
+    // (resized_y_first, then resized_yx); both are compiled in and
+    // pass_order picks one at runtime.
+    Func as_float, clamped, resized_x_first, resized_xy, resized_y_first, resized_yx,
         unnormalized_kernel_x, unnormalized_kernel_y,
         kernel_x, kernel_y,
-        kernel_sum_x, kernel_sum_y;
+        kernel_sum_x, kernel_sum_y, kernel_table;
+    std::vector<Func> prefiltered;
 
     void generate() {
 
@@ -82,63 +95,164 @@ public:
                                                   {{input.dim(0).min(), input.dim(0).extent()},
                                                    {input.dim(1).min(), input.dim(1).extent()}});
 
-        // Handle different types by just casting to float
-        as_float(x, y, c) = cast<float>(clamped(x, y, c));
+        // Everything after this works in float, in units of the output
+        // type: [0, 1] for float, the full range for integers. Input
+        // and output types are independent, and mapping one range onto
+        // the other here means neither side needs a separate conversion
+        // pass.
+        as_float(x, y, c) = cast<float>(clamped(x, y, c)) * (value_range(output.type()) / value_range(input.type()));
+
+        // Each level averages 2x2 blocks of the one before. Pixel x of
+        // level n is centered on (x + 0.5) * 2^n in the input, so the
+        // resize below only has to cover the remaining ratio.
+        Func source = as_float;
+        for (int i = 0; i < prefilter_levels; i++) {
+            Func half("prefiltered_" + std::to_string(i));
+            half(x, y, c) = 0.25f * (source(2 * x, 2 * y, c) + source(2 * x + 1, 2 * y, c) +
+                                     source(2 * x, 2 * y + 1, c) + source(2 * x + 1, 2 * y + 1, c));
+            prefiltered.push_back(half);
+            source = half;
+        }
+        Expr remaining_x = scale_x * (1 << prefilter_levels);
+        Expr remaining_y = scale_y * (1 << prefilter_levels);
 
         // For downscaling, widen the interpolation kernel to perform lowpass
         // filtering.
 
-        Expr kernel_scaling = upsample ? Expr(1.0f) : scale_factor;
+        const int taps = kernel_info(interpolation_type).taps;
+
+        Expr kernel_scaling_x = min(remaining_x, 1.0f);
+        Expr kernel_scaling_y = min(remaining_y, 1.0f);
 
-        Expr kernel_radius = 0.5f * kernel_info[interpolation_type].taps / kernel_scaling;
+        Expr kernel_radius_x = 0.5f * taps / kernel_scaling_x;
+        Expr kernel_radius_y = 0.5f * taps / kernel_scaling_y;
 
-        Expr kernel_taps = ceil(kernel_info[interpolation_type].taps / kernel_scaling);
+        Expr kernel_taps_x = ceil(taps / kernel_scaling_x);
+        Expr kernel_taps_y = ceil(taps / kernel_scaling_y);
 
         // source[xy] are the (non-integer) coordinates inside the source image
-        Expr sourcex = (x + 0.5f) / scale_factor - 0.5f;
-        Expr sourcey = (y + 0.5f) / scale_factor - 0.5f;
+        Expr sourcex = (x + 0.5f) / remaining_x - 0.5f;
+        Expr sourcey = (y + 0.5f) / remaining_y - 0.5f;
 
         // Initialize interpolation kernels. Since we allow an arbitrary
         // scaling factor, the filter coefficients are different for each x
         // and y coordinate.
-        Expr beginx = cast<int>(ceil(sourcex - kernel_radius));
-        Expr beginy = cast<int>(ceil(sourcey - kernel_radius));
+        Expr beginx = cast<int>(ceil(sourcex - kernel_radius_x));
+        Expr beginy = cast<int>(ceil(sourcey - kernel_radius_y));
 
-        RDom r(0, cast<int>(kernel_taps));
-        const KernelInfo &info = kernel_info[interpolation_type];
+        RDom rx(0, cast<int>(kernel_taps_x));
+        RDom ry(0, cast<int>(kernel_taps_y));
 
-        unnormalized_kernel_x(x, k) = info.kernel((k + beginx - sourcex) * kernel_scaling);
-        unnormalized_kernel_y(y, k) = info.kernel((k + beginy - sourcey) * kernel_scaling);
+        unnormalized_kernel_x(x, k) = evaluate_kernel((k + beginx - sourcex) * kernel_scaling_x);
+        unnormalized_kernel_y(y, k) = evaluate_kernel((k + beginy - sourcey) * kernel_scaling_y);
 
-        kernel_sum_x(x) = sum(unnormalized_kernel_x(x, r), "kernel_sum_x");
-        kernel_sum_y(y) = sum(unnormalized_kernel_y(y, r), "kernel_sum_y");
+        kernel_sum_x(x) = sum(unnormalized_kernel_x(x, rx), "kernel_sum_x");
+        kernel_sum_y(y) = sum(unnormalized_kernel_y(y, ry), "kernel_sum_y");
 
         kernel_x(x, k) = unnormalized_kernel_x(x, k) / kernel_sum_x(x);
         kernel_y(y, k) = unnormalized_kernel_y(y, k) / kernel_sum_y(y);
 
-        // Perform separable resizing. The resize in x vectorizes
-        // poorly compared to the resize in y, so do it first if we're
-        // upsampling, and do it second if we're downsampling.
+        // Perform separable resizing, in either order.
+        Type storage = storage_type();
+        resized_x_first(x, y, c) = cast(storage, sum(kernel_x(x, rx) * source(rx + beginx, y, c), "resized_x_first"));
+        resized_xy(x, y, c) = sum(kernel_y(y, ry) * cast<float>(resized_x_first(x, ry + beginy, c)), "resized_xy");
+
+        resized_y_first(x, y, c) = cast(storage, sum(kernel_y(y, ry) * source(x, ry + beginy, c), "resized_y_first"));
+        resized_yx(x, y, c) = sum(kernel_x(x, rx) * cast<float>(resized_y_first(rx + beginx, y, c)), "resized_yx");
+
         Func resized;
-        if (upsample) {
-            resized_x(x, y, c) = sum(kernel_x(x, r) * as_float(r + beginx, y, c), "resized_x");
-            resized_y(x, y, c) = sum(kernel_y(y, r) * resized_x(x, r + beginy, c), "resized_y");
-            resized = resized_y;
+        if (pass_order_fixed == PassOrder::XFirst) {
+            resized(x, y, c) = resized_xy(x, y, c);
+        } else if (pass_order_fixed == PassOrder::YFirst) {
+            resized(x, y, c) = resized_yx(x, y, c);
         } else {
-            resized_y(x, y, c) = sum(kernel_y(y, r) * as_float(x, r + beginy, c), "resized_y");
-            resized_x(x, y, c) = sum(kernel_x(x, r) * resized_y(r + beginx, y, c), "resized_x");
-            resized = resized_x;
+            // This computes both orders wherever the schedule doesn't
+            // specialize on pass_order (substituting it folds the select
+            // and the require away), so every schedule path below must,
+            // and anything but 1 or 2 fails.
+            resized(x, y, c) = require(pass_order == 1 || pass_order == 2,
+                                       select(pass_order == 1, resized_xy(x, y, c), resized_yx(x, y, c)),
+                                       "pass_order must be 1 or 2, not", pass_order);
         }
 
-        if (input.type().is_float()) {
+        if (output.type().is_float()) {
             output(x, y, c) = clamp(resized(x, y, c), 0.0f, 1.0f);
         } else {
-            output(x, y, c) = saturating_cast(input.type(), resized(x, y, c));
+            output(x, y, c) = saturating_cast(output.type(), resized(x, y, c));
         }
     }
 
+    Type storage_type() const {
+        switch (intermediate_type) {
+        case Float16:
+            if (get_target().arch == Target::X86 && !get_target().has_feature(Target::F16C)) {
+                return BFloat(16);
+            }
+            return Float(16);
+        case BFloat16:
+            return BFloat(16);
+        default:
+            return Float(32);
+        }
+    }
+
+    bool use_kernel_table() const {
+        return fast_kernel && kernel_info(interpolation_type).tabulate;
+    }
+
+    Expr evaluate_kernel(Expr x) {
+        const KernelInfo &info = kernel_info(interpolation_type);
+        if (!use_kernel_table()) {
+            return info.kernel(x);
+        }
+        if (!kernel_table.defined()) {
+            kernel_table = make_kernel_table(info);
+        }
+        return lookup_kernel(kernel_table, info, x);
+    }
+
     void schedule() {
-        Var xi, yi;
+        if (auto_schedule) {
+            // Leave it all to the auto-scheduler (see ../autoschedule),
+            // with estimates for a 2x downsample of a 4K image. Nothing
+            // specializes on pass_order here, so the order has to be
+            // built in.
+            user_assert(pass_order_fixed != PassOrder::Runtime)
+                << "auto_schedule needs pass_order_fixed=x or y; with a runtime pass order, "
+                << "the pipeline would compute both orders\n";
+            input.set_estimates({{0, 3840}, {0, 2160}, {0, 3}});
+            scale_x.set_estimate(0.5f);
+            scale_y.set_estimate(0.5f);
+            pass_order.set_estimate(2);
+            output.set_estimates({{0, 1920}, {0, 1080}, {0, 3}});
+            return;
+        }
+
+        Expr small = output.dim(0).extent() <= small_size && output.dim(1).extent() <= small_size;
+        // The intermediates reach the input only through clamped, and
+        // the kernels they read are computed over whatever region they
+        // need. So rounding up or shifting their vectors changes how
+        // many of their points are computed, never what is read.
+        // Epilogue guards them.
+        TailStrategy intermediate_tail = tail_strategy();
+
+        for (Func half : prefiltered) {
+            half.compute_root();
+            if (small_size > 0) {
+                half.specialize(small)
+                    .vectorize(x, 8, intermediate_tail);
+            }
+            half
+                .parallel(y)
+                .vectorize(x, 8, intermediate_tail);
+        }
+
+        if (use_kernel_table()) {
+            kernel_table
+                .compute_root()
+                .vectorize(kernel_table.args()[0], 8);
+        }
+
         unnormalized_kernel_x
             .compute_at(kernel_x, x)
             .vectorize(x);
@@ -161,28 +275,30 @@ public:
             .reorder(k, y)
             .vectorize(y, 8);
 
-        if (upsample) {
-            output
-                .tile(x, y, xi, yi, 16, 64)
-                .parallel(y)
-                .vectorize(xi);
-            resized_x
-                .compute_at(output, x)
-                .vectorize(x, 8);
-            as_float
-                .compute_at(output, y)
-                .vectorize(x, 8);
+        std::vector<Stage> output_stages;
+        if (tail == ResizeTail::Epilogue) {
+            Expr aligned = output.dim(0).extent() % 32 == 0 && output.dim(1).extent() % 64 == 0;
+            schedule_output(output.specialize(aligned), TailStrategy::RoundUp, small, output_stages);
+            schedule_output(Stage(output), TailStrategy::GuardWithIf, small, output_stages);
         } else {
-            output
-                .tile(x, y, xi, yi, 32, 8)
-                .parallel(y)
-                .vectorize(xi);
-            resized_y
+            schedule_output(Stage(output), tail_strategy(), small, output_stages);
+        }
+
+        resized_x_first
+            .compute_at(output, x)
+            .vectorize(x, 8, intermediate_tail);
+        if (prefiltered.empty()) {
+            // Only the x pass should stage the input per strip; the
+            // y pass reads it straight from the input.
+            as_float.in(resized_x_first)
                 .compute_at(output, y)
-                .vectorize(x, 8);
-            resized_x
-                .compute_at(output, xi);
+                .vectorize(x, 8, intermediate_tail);
         }
+        resized_y_first
+            .compute_at(output, y)
+            .vectorize(x, 8, intermediate_tail);
+        resized_yx
+            .compute_at(output, xi);
 
         // Allow the input and output to have arbitrary memory layout,
         // and add some specializations for a few common cases. If
@@ -210,16 +326,298 @@ public:
                             input.dim(2).min() == 0 &&
                             input.dim(2).extent() == 4);
 
-        output.specialize(planar);
+        for (Stage s : output_stages) {
+            s.specialize(planar);
+        }
+
+        // Interleaved frames straight from a camera or decoder, wrapped
+        // in place (see external_buffer.h) and resized to planar output.
+        // Knowing the input's strides turns the gathers of the stages
+        // reading it into strided loads.
+        Expr packed_rgb_to_planar = (output.dim(0).stride() == 1 &&
+                                     input.dim(0).stride() == 3 &&
+                                     input.dim(2).stride() == 1);
+        Expr packed_rgba_to_planar = (output.dim(0).stride() == 1 &&
+                                      input.dim(0).stride() == 4 &&
+                                      input.dim(2).stride() == 1);
+        std::vector<Func> input_readers = {resized_y_first};
+        if (prefiltered.empty()) {
+            input_readers.push_back(as_float.in(resized_x_first));
+        } else {
+            input_readers.push_back(prefiltered[0]);
+        }
+        for (Func f : input_readers) {
+            f.specialize(packed_rgb_to_planar);
+            f.specialize(packed_rgba_to_planar);
+        }
+
+        schedule_packed(output_stages, packed_rgb);
+        schedule_packed(output_stages, packed_rgba);
+    }
+
+    // Tile s (the output, or a specialization of it) for each pass
+    // order and for small outputs, appending every resulting stage to
+    // output_stages.
+    void schedule_output(Stage s, TailStrategy strategy, Expr small, std::vector<Stage> &output_stages) {
+        // Small outputs compute their tiles serially, in either order.
+        if (small_size > 0) {
+            for_each_pass_order(s.specialize(small), output_stages, [&](Stage o, bool) {
+                o.tile(x, y, xi, yi, natural_vector_size(Float(32)), 8, strategy)
+                    .vectorize(xi);
+            });
+        }
+
+        for_each_pass_order(s, output_stages, [&](Stage o, bool x_first) {
+            if (x_first) {
+                // What upsampling wants: tall tiles, so each row of the
+                // x pass is reused by many output rows.
+                o.tile(x, y, xi, yi, 16, 64, strategy)
+                    .parallel(y)
+                    .vectorize(xi);
+            } else {
+                // What downsampling wants
+                o.tile(x, y, xi, yi, 32, 8, strategy)
+                    .parallel(y)
+                    .vectorize(xi);
+            }
+        });
+    }
+
+    // Schedule s for each pass order the variant runs, appending the
+    // stages scheduled to output_stages. With a runtime order, each is
+    // its own specialization on pass_order, and any other value fails;
+    // a built-in order schedules s itself.
+    void for_each_pass_order(Stage s, std::vector<Stage> &output_stages, const std::function<void(Stage, bool)> &schedule_order) {
+        if (pass_order_fixed != PassOrder::Runtime) {
+            schedule_order(s, pass_order_fixed == PassOrder::XFirst);
+            output_stages.push_back(s);
+            return;
+        }
+        for (int order : {1, 2}) {
+            Stage branch = s.specialize(pass_order == order);
+            schedule_order(branch, order == 1);
+            output_stages.push_back(branch);
+        }
+        s.specialize_fail("pass_order must be 1 or 2");
+    }
 
-        output.specialize(packed_rgb)
-            .reorder(c, xi, yi, x, y)
-            .unroll(c);
+    TailStrategy tail_strategy() const {
+        switch (tail) {
+        case ResizeTail::ShiftInwards:
+            return TailStrategy::ShiftInwards;
+        case ResizeTail::GuardWithIf:
+        case ResizeTail::Epilogue:
+            return TailStrategy::GuardWithIf;
+        case ResizeTail::RoundUp:
+            return TailStrategy::RoundUp;
+        default:
+            return TailStrategy::Auto;
+        }
+    }
+
+    // Packed layouts want the channel loop innermost and unrolled in
+    // every stage that touches pixel data, not just the output. With
+    // c inside the vectorized x loop, the stride-3/4 vector loads of
+    // the input become one dense load followed by a deinterleaving
+    // shuffle, the kernel weights (which don't depend on c) are reused
+    // by all channels of a pixel while still in registers or L1, and
+    // the unrolled stores to adjacent channels are fused back into a
+    // single interleaving store.
+    void schedule_packed(const std::vector<Stage> &output_stages, Expr packed) {
+        for (Stage s : output_stages) {
+            s.specialize(packed)
+                .reorder(c, xi, yi, x, y)
+                .unroll(c);
+        }
+
+        std::vector<Func> per_pixel = {resized_x_first, resized_y_first, resized_yx};
+        if (prefiltered.empty()) {
+            per_pixel.push_back(as_float.in(resized_x_first));
+        }
+        for (Func f : per_pixel) {
+            f.specialize(packed)
+                .reorder(c, x, y)
+                .unroll(c);
+        }
+    }
+};
 
-        output.specialize(packed_rgba)
-            .reorder(c, xi, yi, x, y)
-            .unroll(c);
+// Just the normalized resampling weights of one axis of Resize,
+// i.e. its kernel_x. This lets us time kernel setup separately from
+// the convolution, and compare the tabulated kernels against the
+// closed form.
+class ResizeKernel : public Halide::Generator<ResizeKernel> {
+public:
+    GeneratorParam<InterpolationType> interpolation_type{"interpolation_type", Cubic, {{"box", Box}, {"linear", Linear}, {"cubic", Cubic}, {"lanczos", Lanczos}}};
+    GeneratorParam<bool> fast_kernel{"fast_kernel", true};
+
+    Input<float> scale_factor{"scale_factor"};
+    Output<Buffer<float>> weights{"weights", 2};
+
+    Var x, k;
+    Func unnormalized, kernel_sum, kernel_table;
+
+    void generate() {
+        const KernelInfo &info = kernel_info(interpolation_type);
+        const bool tabulated = fast_kernel && info.tabulate;
+        if (tabulated) {
+            kernel_table = make_kernel_table(info);
+        }
+
+        // The same mapping from output to source coordinates as Resize
+        Expr kernel_scaling = min(scale_factor, 1.0f);
+        Expr kernel_radius = 0.5f * info.taps / kernel_scaling;
+        Expr kernel_taps = ceil(info.taps / kernel_scaling);
+        Expr sourcex = (x + 0.5f) / scale_factor - 0.5f;
+        Expr beginx = cast<int>(ceil(sourcex - kernel_radius));
+
+        Expr kx = (k + beginx - sourcex) * kernel_scaling;
+        unnormalized(x, k) = tabulated ? lookup_kernel(kernel_table, info, kx) : info.kernel(kx);
+
+        RDom r(0, cast<int>(kernel_taps));
+        kernel_sum(x) = sum(unnormalized(x, r), "kernel_sum");
+        weights(x, k) = unnormalized(x, k) / kernel_sum(x);
+    }
+
+    void schedule() {
+        if (kernel_table.defined()) {
+            kernel_table
+                .compute_root()
+                .vectorize(kernel_table.args()[0], 8);
+        }
+        unnormalized
+            .compute_at(weights, x)
+            .vectorize(x);
+        kernel_sum
+            .compute_at(weights, x)
+            .vectorize(x);
+        weights
+            .reorder(k, x)
+            .vectorize(x, 8);
+    }
+};
+
+// A cubic resize of an 8-bit image to float32, y pass first, in
+// parallel strips of 32 output rows. The two generators below share
+// it and differ only in where the source rows come from. One reads an
+// image decoded up front; the other decodes each strip's rows with an
+// extern stage right before they are read, while they are in cache.
+template<typename T>
+class StripResize : public Halide::Generator<T> {
+protected:
+    Var x{"x"}, y{"y"}, c{"c"}, k{"k"}, yi{"yi"};
+    Func as_float{"as_float"}, unnormalized_kernel_x, unnormalized_kernel_y,
+        kernel_sum_x, kernel_sum_y, kernel_x{"kernel_x"}, kernel_y{"kernel_y"}, resized_y{"resized_y"};
+
+    // The resized image, with the same mapping from output to source
+    // coordinates as Resize. clamped must be defined everywhere.
+    Func resize(Func clamped, Expr scale_x, Expr scale_y) {
+        const KernelInfo &info = kernel_info(Cubic);
+        as_float(x, y, c) = cast<float>(clamped(x, y, c)) / 255.0f;
+
+        Expr kernel_scaling_x = min(scale_x, 1.0f);
+        Expr kernel_scaling_y = min(scale_y, 1.0f);
+        Expr kernel_taps_x = ceil(info.taps / kernel_scaling_x);
+        Expr kernel_taps_y = ceil(info.taps / kernel_scaling_y);
+        Expr sourcex = (x + 0.5f) / scale_x - 0.5f;
+        Expr sourcey = (y + 0.5f) / scale_y - 0.5f;
+        Expr beginx = cast<int>(ceil(sourcex - 0.5f * info.taps / kernel_scaling_x));
+        Expr beginy = cast<int>(ceil(sourcey - 0.5f * info.taps / kernel_scaling_y));
+        RDom rx(0, cast<int>(kernel_taps_x));
+        RDom ry(0, cast<int>(kernel_taps_y));
+
+        unnormalized_kernel_x(x, k) = info.kernel((k + beginx - sourcex) * kernel_scaling_x);
+        unnormalized_kernel_y(y, k) = info.kernel((k + beginy - sourcey) * kernel_scaling_y);
+        kernel_sum_x(x) = sum(unnormalized_kernel_x(x, rx), "kernel_sum_x");
+        kernel_sum_y(y) = sum(unnormalized_kernel_y(y, ry), "kernel_sum_y");
+        kernel_x(x, k) = unnormalized_kernel_x(x, k) / kernel_sum_x(x);
+        kernel_y(y, k) = unnormalized_kernel_y(y, k) / kernel_sum_y(y);
+
+        resized_y(x, y, c) = sum(kernel_y(y, ry) * as_float(x, ry + beginy, c), "resized_y");
+        Func resized("resized");
+        resized(x, y, c) = clamp(sum(kernel_x(x, rx) * resized_y(rx + beginx, y, c), "resized_x"), 0.0f, 1.0f);
+        return resized;
+    }
+
+    // Each strip of output computes the y pass over its rows, for every
+    // channel, and then the x pass.
+    void schedule_strips(Func output) {
+        kernel_x
+            .compute_root()
+            .reorder(k, x)
+            .vectorize(x, 8);
+        kernel_y
+            .compute_root()
+            .reorder(k, y)
+            .vectorize(y, 8);
+        output
+            .split(y, y, yi, 32)
+            .reorder(x, yi, c, y)
+            .parallel(y)
+            .vectorize(x, 8);
+        resized_y
+            .compute_at(output, y)
+            .vectorize(x, 8);
+    }
+};
+
+// StripResize of a decoded image in memory, the way resize.cpp runs
+// after load_image
+class ResizePredecoded : public StripResize<ResizePredecoded> {
+public:
+    Input<Buffer<uint8_t>> input{"input", 3};
+    Input<float> scale_x{"scale_x"};
+    Input<float> scale_y{"scale_y"};
+    Output<Buffer<float>> output{"output", 3};
+
+    void generate() {
+        Func clamped = BoundaryConditions::repeat_edge(input,
+                                                       {{input.dim(0).min(), input.dim(0).extent()},
+                                                        {input.dim(1).min(), input.dim(1).extent()}});
+        output(x, y, c) = resize(clamped, scale_x, scale_y)(x, y, c);
+    }
+
+    void schedule() {
+        schedule_strips(output);
+    }
+};
+
+// StripResize of a RowCodedImage (see row_codec.h), whose rows an
+// extern stage decodes per strip, as they are needed. Strips overlap by
+// the kernel's taps, so a few rows are decoded twice.
+class ResizeExternDecode : public StripResize<ResizeExternDecode> {
+public:
+    // The RowCodedImage, width x height, with at least as many channels
+    // as the output
+    Input<void *> image{"image"};
+    Input<int> width{"width"};
+    Input<int> height{"height"};
+    Input<float> scale_x{"scale_x"};
+    Input<float> scale_y{"scale_y"};
+    Output<Buffer<float>> output{"output", 3};
+
+    Func decoded{"decoded"};
+
+    void generate() {
+        // int decode_rows(void *image, halide_buffer_t *out) fills out
+        // with the region of the image it covers.
+        std::vector<ExternFuncArgument> args = {Expr(image)};
+        decoded.define_extern("decode_rows", args, UInt(8), {x, y, c});
+
+        // Clamping keeps every region asked of decode_rows inside the
+        // image.
+        Func clamped;
+        clamped(x, y, c) = decoded(clamp(x, 0, width - 1), clamp(y, 0, height - 1), c);
+        output(x, y, c) = resize(clamped, scale_x, scale_y)(x, y, c);
+    }
+
+    void schedule() {
+        schedule_strips(output);
+        decoded.compute_at(output, y);
     }
 };
 
 HALIDE_REGISTER_GENERATOR(Resize, resize);
+HALIDE_REGISTER_GENERATOR(ResizeKernel, resize_kernel);
+HALIDE_REGISTER_GENERATOR(ResizePredecoded, resize_predecoded);
+HALIDE_REGISTER_GENERATOR(ResizeExternDecode, resize_extern_decode);
@@ -0,0 +1,95 @@
+#ifndef RESIZE_KERNELS_H
+#define RESIZE_KERNELS_H
+
+// The resampling kernels of the resize app, shared with the other
+// generators that filter with them (see examples/warp). Everything is
+// inline and names Halide explicitly, as more than one translation unit
+// of a program may include this.
+
+#include "Halide.h"
+
+enum InterpolationType {
+    Box,
+    Linear,
+    Cubic,
+    Lanczos
+};
+
+inline Halide::Expr kernel_box(Halide::Expr x) {
+    Halide::Expr xx = Halide::abs(x);
+    return Halide::select(xx <= 0.5f, 1.0f, 0.0f);
+}
+
+inline Halide::Expr kernel_linear(Halide::Expr x) {
+    Halide::Expr xx = Halide::abs(x);
+    return Halide::select(xx < 1.0f, 1.0f - xx, 0.0f);
+}
+
+inline Halide::Expr kernel_cubic(Halide::Expr x) {
+    Halide::Expr xx = Halide::abs(x);
+    Halide::Expr xx2 = xx * xx;
+    Halide::Expr xx3 = xx2 * xx;
+    float a = -0.5f;
+
+    return Halide::select(xx < 1.0f, (a + 2.0f) * xx3 - (a + 3.0f) * xx2 + 1,
+                          Halide::select(xx < 2.0f, a * xx3 - 5 * a * xx2 + 8 * a * xx - 4.0f * a,
+                                         0.0f));
+}
+
+inline Halide::Expr sinc(Halide::Expr x) {
+    x *= 3.14159265359f;
+    return Halide::sin(x) / x;
+}
+
+inline Halide::Expr kernel_lanczos(Halide::Expr x) {
+    Halide::Expr value = sinc(x) * sinc(x / 3);
+    value = Halide::select(x == 0.0f, 1.0f, value);        // Take care of singularity at zero
+    value = Halide::select(x > 3 || x < -3, 0.0f, value);  // Clamp to zero out of bounds
+    return value;
+}
+
+struct KernelInfo {
+    const char *name;
+    int taps;
+    Halide::Expr (*kernel)(Halide::Expr);
+    bool tabulate;  // Cheaper to look up than to evaluate
+};
+
+// The kernel of an interpolation type. The table is a local static, so
+// that every translation unit shares the one copy.
+inline const KernelInfo &kernel_info(InterpolationType type) {
+    static const KernelInfo info[] = {
+        {"box", 1, kernel_box, false},
+        {"linear", 2, kernel_linear, false},
+        {"cubic", 4, kernel_cubic, true},
+        {"lanczos", 6, kernel_lanczos, true}};
+    return info[type];
+}
+
+// Samples per unit of |x| in a tabulated kernel. Linear interpolation
+// between samples spaced h apart is off by at most h^2/8 * max|f''|,
+// which for h = 1/1024 is 4.4e-7 for lanczos (max|f''| = 3.66) and
+// 6.0e-7 for cubic (max|f''| = 5). That is within a few ulps of the
+// float32 closed form, and far below the quantization of 16-bit output.
+const int kernel_table_resolution = 1024;
+
+// The kernel sampled at |x| = i / kernel_table_resolution, out to its
+// radius plus one sample so that the lerp below never reads past it.
+inline Halide::Func make_kernel_table(const KernelInfo &info) {
+    Halide::Func table("kernel_table");
+    Halide::Var i;
+    table(i) = info.kernel(i / float(kernel_table_resolution));
+    return table;
+}
+
+// Evaluate the kernel by interpolating its table instead of calling
+// info.kernel, which for lanczos costs two sin() per tap.
+inline Halide::Expr lookup_kernel(Halide::Func table, const KernelInfo &info, Halide::Expr x) {
+    const int radius = info.taps / 2 * kernel_table_resolution;
+    Halide::Expr t = Halide::abs(x) * kernel_table_resolution;
+    Halide::Expr i = Halide::clamp(Halide::cast<int>(t), 0, radius);
+    Halide::Expr value = Halide::lerp(table(i), table(i + 1), t - i);
+    return Halide::select(t < radius, value, 0.0f);
+}
+
+#endif  // RESIZE_KERNELS_H
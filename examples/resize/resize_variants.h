@@ -0,0 +1,142 @@
+#ifndef RESIZE_VARIANTS_H
+#define RESIZE_VARIANTS_H
+
+// The table of AOT-compiled resize variants, shared by the one-shot
+// CLI and the long-running modes of the resize example. Each variant
+// reads one of the types PNGs decode to and writes any of the
+// supported types, converting on the fly.
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "resize_box_uint16_float32.h"
+#include "resize_box_uint16_uint16.h"
+#include "resize_box_uint16_uint8.h"
+#include "resize_box_uint8_float32.h"
+#include "resize_box_uint8_uint16.h"
+#include "resize_box_uint8_uint8.h"
+#include "resize_cubic_uint16_float32.h"
+#include "resize_cubic_uint16_uint16.h"
+#include "resize_cubic_uint16_uint8.h"
+#include "resize_cubic_uint8_float32.h"
+#include "resize_cubic_uint8_uint16.h"
+#include "resize_cubic_uint8_uint8.h"
+#include "resize_lanczos_uint16_float32.h"
+#include "resize_lanczos_uint16_uint16.h"
+#include "resize_lanczos_uint16_uint8.h"
+#include "resize_lanczos_uint8_float32.h"
+#include "resize_lanczos_uint8_uint16.h"
+#include "resize_lanczos_uint8_uint8.h"
+#include "resize_linear_uint16_float32.h"
+#include "resize_linear_uint16_uint16.h"
+#include "resize_linear_uint16_uint8.h"
+#include "resize_linear_uint8_float32.h"
+#include "resize_linear_uint8_uint16.h"
+#include "resize_linear_uint8_uint8.h"
+
+typedef decltype(&resize_box_uint8_float32) ResizeFn;
+
+// Index of an interpolation type in the variant table, or -1.
+inline int interpolation_index(const std::string &name) {
+    if (name == "box") {
+        return 0;
+    } else if (name == "cubic") {
+        return 1;
+    } else if (name == "linear") {
+        return 2;
+    } else if (name == "lanczos") {
+        return 3;
+    }
+    return -1;
+}
+
+// Kernel width in input pixels at scale 1 of the interpolation type at
+// interpolation_idx (see kernel_info in resize_kernels.h).
+inline int interpolation_taps(int interpolation_idx) {
+    const int taps[] = {1, 4, 2, 6};
+    return taps[interpolation_idx];
+}
+
+// The pass_order argument of the resize variants: 1 to run the x pass
+// first, 2 for the y pass. prefilter_levels is the variant's (see
+// pick_multistage in resize.cpp), as its kernels only cover the ratio
+// left after the 2x box levels.
+//
+// The resize in x vectorizes poorly compared to the resize in y, so its
+// taps count twice. Per output pixel, x first costs the x pass over
+// 1 / remaining_y intermediate rows plus the y pass, and y first costs
+// the y pass over 1 / remaining_x intermediate columns plus the x pass.
+// This comes out as x first when upsampling and y first when
+// downsampling, and also does the right thing when the two ratios
+// differ.
+inline int resize_pass_order(int interpolation_idx, float scale_x, float scale_y, int prefilter_levels = 0) {
+    const float remaining_x = scale_x * (1 << prefilter_levels);
+    const float remaining_y = scale_y * (1 << prefilter_levels);
+    const int taps = interpolation_taps(interpolation_idx);
+    const float taps_x = std::ceil(taps / std::min(remaining_x, 1.0f));
+    const float taps_y = std::ceil(taps / std::min(remaining_y, 1.0f));
+    const float cost_x_first = 2 * taps_x / remaining_y + taps_y;
+    const float cost_y_first = taps_y / remaining_x + 2 * taps_x;
+    return cost_x_first < cost_y_first ? 1 : 2;
+}
+
+// Index of an output element type in the variant table, or -1.
+inline int type_index(const std::string &name) {
+    if (name == "float32") {
+        return 0;
+    } else if (name == "uint8") {
+        return 1;
+    } else if (name == "uint16") {
+        return 2;
+    }
+    return -1;
+}
+
+inline halide_type_t type_of_index(int type_idx) {
+    const halide_type_t types[] = {halide_type_of<float>(), halide_type_of<uint8_t>(), halide_type_of<uint16_t>()};
+    return types[type_idx];
+}
+
+// The variant reading input_type and writing the type_idx type, or
+// nullptr if there is none.
+inline ResizeFn find_resize_variant(halide_type_t input_type, int type_idx, int interpolation_idx) {
+    static const ResizeFn variants[2][3][4] =
+        {{{&resize_box_uint8_float32,
+           &resize_cubic_uint8_float32,
+           &resize_linear_uint8_float32,
+           &resize_lanczos_uint8_float32},
+          {&resize_box_uint8_uint8,
+           &resize_cubic_uint8_uint8,
+           &resize_linear_uint8_uint8,
+           &resize_lanczos_uint8_uint8},
+          {&resize_box_uint8_uint16,
+           &resize_cubic_uint8_uint16,
+           &resize_linear_uint8_uint16,
+           &resize_lanczos_uint8_uint16}},
+         {{&resize_box_uint16_float32,
+           &resize_cubic_uint16_float32,
+           &resize_linear_uint16_float32,
+           &resize_lanczos_uint16_float32},
+          {&resize_box_uint16_uint8,
+           &resize_cubic_uint16_uint8,
+           &resize_linear_uint16_uint8,
+           &resize_lanczos_uint16_uint8},
+          {&resize_box_uint16_uint16,
+           &resize_cubic_uint16_uint16,
+           &resize_linear_uint16_uint16,
+           &resize_lanczos_uint16_uint16}}};
+
+    int input_idx = -1;
+    if (input_type == halide_type_of<uint8_t>()) {
+        input_idx = 0;
+    } else if (input_type == halide_type_of<uint16_t>()) {
+        input_idx = 1;
+    }
+    if (input_idx < 0 || type_idx < 0 || type_idx >= 3 || interpolation_idx < 0 || interpolation_idx >= 4) {
+        return nullptr;
+    }
+    return variants[input_idx][type_idx][interpolation_idx];
+}
+
+#endif  // RESIZE_VARIANTS_H
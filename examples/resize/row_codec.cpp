@@ -0,0 +1,66 @@
+#include "row_codec.h"
+
+RowCodedImage::RowCodedImage(Halide::Runtime::Buffer<uint8_t> image)
+    : width_(image.width()), height_(image.height()), channels_(image.channels()),
+      data_((size_t)image.width() * image.height() * image.channels()) {
+    uint8_t *dst = data_.data();
+    for (int c = 0; c < channels_; c++) {
+        for (int y = 0; y < height_; y++) {
+            uint8_t previous = 0;
+            for (int x = 0; x < width_; x++) {
+                uint8_t value = image(image.dim(0).min() + x, image.dim(1).min() + y, image.dim(2).min() + c);
+                *dst++ = value - previous;
+                previous = value;
+            }
+        }
+    }
+}
+
+void RowCodedImage::decode_row(int c, int y, int x_min, int x_extent, uint8_t *dst, int stride) const {
+    const uint8_t *src = data_.data() + ((size_t)c * height_ + y) * width_;
+    uint8_t value = 0;
+    // The pixels left of x_min still have to be summed, but not stored.
+    for (int x = 0; x < x_min; x++) {
+        value += src[x];
+    }
+    for (int x = x_min; x < x_min + x_extent; x++) {
+        value += src[x];
+        *dst = value;
+        dst += stride;
+    }
+    rows_decoded_.fetch_add(1, std::memory_order_relaxed);
+}
+
+Halide::Runtime::Buffer<uint8_t> RowCodedImage::decode() const {
+    Halide::Runtime::Buffer<uint8_t> image(width_, height_, channels_);
+    for (int c = 0; c < channels_; c++) {
+        for (int y = 0; y < height_; y++) {
+            decode_row(c, y, 0, width_, &image(0, y, c), image.dim(0).stride());
+        }
+    }
+    return image;
+}
+
+extern "C" int decode_rows(void *image_ptr, halide_buffer_t *out) {
+    // Nothing to report in a bounds query, as the stage has no input
+    // buffers.
+    if (out->is_bounds_query()) {
+        return 0;
+    }
+
+    const RowCodedImage *image = (const RowCodedImage *)image_ptr;
+    Halide::Runtime::Buffer<uint8_t> region(*out);
+    if (region.dim(0).min() < 0 || region.dim(0).max() >= image->width() ||
+        region.dim(1).min() < 0 || region.dim(1).max() >= image->height() ||
+        region.dim(2).min() < 0 || region.dim(2).max() >= image->channels()) {
+        return -1;
+    }
+
+    for (int c = region.dim(2).min(); c <= region.dim(2).max(); c++) {
+        for (int y = region.dim(1).min(); y <= region.dim(1).max(); y++) {
+            image->decode_row(c, y, region.dim(0).min(), region.dim(0).extent(),
+                              &region(region.dim(0).min(), y, c), region.dim(0).stride());
+        }
+    }
+    return 0;
+}
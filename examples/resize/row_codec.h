@@ -0,0 +1,62 @@
+#ifndef ROW_CODEC_H
+#define ROW_CODEC_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "HalideBuffer.h"
+
+// A lightweight 8-bit image codec that can decode any range of rows on
+// its own. Each row of each channel is stored as the differences
+// between neighbouring pixels (PNG's Sub filter without the deflate),
+// so decoding a row is a running sum from its first pixel.
+//
+// This is what the resize_extern_decode pipeline calls, through
+// decode_rows below, to decode only the rows each strip of its output
+// needs, just before it reads them.
+class RowCodedImage {
+public:
+    // Encode image, which may have any layout.
+    explicit RowCodedImage(Halide::Runtime::Buffer<uint8_t> image);
+
+    RowCodedImage(const RowCodedImage &) = delete;
+    RowCodedImage &operator=(const RowCodedImage &) = delete;
+
+    int width() const {
+        return width_;
+    }
+    int height() const {
+        return height_;
+    }
+    int channels() const {
+        return channels_;
+    }
+
+    // Decode columns [x_min, x_min + x_extent) of row y of channel c to
+    // dst, stride elements apart.
+    void decode_row(int c, int y, int x_min, int x_extent, uint8_t *dst, int stride) const;
+
+    // The whole image, planar, the way load_image would give it
+    Halide::Runtime::Buffer<uint8_t> decode() const;
+
+    // Rows (of one channel) decoded since the last reset_rows_decoded()
+    int64_t rows_decoded() const {
+        return rows_decoded_;
+    }
+    void reset_rows_decoded() {
+        rows_decoded_ = 0;
+    }
+
+private:
+    int width_, height_, channels_;
+    std::vector<uint8_t> data_;
+    mutable std::atomic<int64_t> rows_decoded_{0};
+};
+
+// The extern stage of resize_extern_decode: fill out with the region
+// of the RowCodedImage image it covers. out must lie within the image;
+// the pipeline clamps its coordinates to make sure of that.
+extern "C" int decode_rows(void *image, halide_buffer_t *out);
+
+#endif  // ROW_CODEC_H
@@ -0,0 +1,14 @@
+#ifndef VALUE_RANGE_H
+#define VALUE_RANGE_H
+
+// The pixel value range shared by the generators that convert between
+// element types (resize, warp and convert): float images hold [0, 1],
+// integer ones use the whole range of the type.
+
+#include "Halide.h"
+
+inline float value_range(Halide::Type t) {
+    return t.is_float() ? 1.0f : (float)((1 << t.bits()) - 1);
+}
+
+#endif  // VALUE_RANGE_H
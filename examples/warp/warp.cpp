@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "HalideBuffer.h"
+#include "halide_image_io.h"
+
+#include "halide_bench.h"
+#include "resize_box_uint8_uint8.h"
+#include "resize_cubic_uint8_uint8.h"
+#include "resize_lanczos_uint8_uint8.h"
+#include "resize_linear_uint8_uint8.h"
+#include "warp_box.h"
+#include "warp_cubic.h"
+#include "warp_lanczos.h"
+#include "warp_kind.h"
+#include "warp_linear.h"
+
+using Halide::Runtime::Buffer;
+
+// Speed of the warp pipelines on a few kinds of transform, and a check
+// that a pure scale matches the resize app with the same kernel.
+
+typedef decltype(&warp_cubic) WarpFn;
+typedef decltype(&resize_cubic_uint8_uint8) ResizeFn;
+
+const int iters = 10;
+
+// Row-major 3x3, mapping output pixel centers to input coordinates.
+struct Transform {
+    float m[9];
+};
+
+Transform multiply(const Transform &a, const Transform &b) {
+    Transform r;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            r.m[i * 3 + j] = 0;
+            for (int k = 0; k < 3; k++) {
+                r.m[i * 3 + j] += a.m[i * 3 + k] * b.m[k * 3 + j];
+            }
+        }
+    }
+    return r;
+}
+
+Transform translate(float dx, float dy) {
+    return {{1, 0, dx, 0, 1, dy, 0, 0, 1}};
+}
+
+// Rotation by degrees about (cx, cy) in the input, which lands on
+// (out_cx, out_cy) in the output.
+Transform rotate_about(float degrees, float cx, float cy, float out_cx, float out_cy) {
+    float a = degrees * 3.14159265f / 180.0f;
+    float c = std::cos(a), s = std::sin(a);
+    Transform rotation = {{c, -s, 0, s, c, 0, 0, 0, 1}};
+    return multiply(translate(cx, cy), multiply(rotation, translate(-out_cx, -out_cy)));
+}
+
+int run_warp(WarpFn fn, Buffer<uint8_t> in, const Transform &t, Buffer<uint8_t> out) {
+    const float *m = t.m;
+    return fn(in, m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8], warp_kind(m), out);
+}
+
+double time_warp(const std::string &name, WarpFn fn, Buffer<uint8_t> in, const Transform &t, Buffer<uint8_t> out, bool *ok) {
+    return HalideBench::benchmark(name, iters, iters, [&]() {
+        if (run_warp(fn, in, t, out) != 0) {
+            *ok = false;
+        }
+    }).median;
+}
+
+int max_difference(Buffer<uint8_t> a, Buffer<uint8_t> b) {
+    int max_diff = 0;
+    a.for_each_element([&](int x, int y, int c) {
+        max_diff = std::max(max_diff, std::abs((int)a(x, y, c) - (int)b(x, y, c)));
+    });
+    return max_diff;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: ./warp_test input.png\n");
+        return 1;
+    }
+
+    Buffer<uint8_t> in = Halide::Tools::load_image(argv[1]);
+    const int width = in.width(), height = in.height();
+
+    struct Interpolation {
+        const char *name;
+        WarpFn warp;
+        ResizeFn resize;
+    } interpolations[] = {
+        {"box", &warp_box, &resize_box_uint8_uint8},
+        {"linear", &warp_linear, &resize_linear_uint8_uint8},
+        {"cubic", &warp_cubic, &resize_cubic_uint8_uint8},
+        {"lanczos", &warp_lanczos, &resize_lanczos_uint8_uint8},
+    };
+
+    bool ok = true;
+
+    // A 2x downscale as a warp is the same resampling as the separable
+    // resize, so the two should agree up to rounding of the
+    // intermediate.
+    const int half_width = width / 2, half_height = height / 2;
+    Transform downscale = {{2, 0, 0, 0, 2, 0, 0, 0, 1}};
+    for (const Interpolation &interp : interpolations) {
+        Buffer<uint8_t> warped(half_width, half_height, 3), resized(half_width, half_height, 3);
+        std::string name = std::string("warp/") + interp.name + "/scale_0.5";
+        double warp_time = time_warp(name, interp.warp, in, downscale, warped, &ok);
+        double resize_time = HalideBench::benchmark(name + "/resize", iters, iters, [&]() {
+            // y first, which resize_pass_order() (resize_variants.h)
+            // picks for any 2x downscale.
+            interp.resize(in, 0.5f, 0.5f, 2, resized);
+        }).median;
+        int diff = max_difference(warped, resized);
+        if (diff > 2) {
+            ok = false;
+        }
+        printf("%-7s  0.5x scale  warp: %8.3f ms  resize: %8.3f ms  (%5.1fx)  max diff: %d\n",
+               interp.name, warp_time * 1000, resize_time * 1000, warp_time / resize_time, diff);
+    }
+
+    // General transforms, all with the output the size of the input.
+    const float cx = width / 2.0f, cy = height / 2.0f;
+    Transform rotated = rotate_about(30, cx, cy, cx, cy);
+
+    // Tilt away from the viewer: the top of the output samples a wider
+    // span of the input than the bottom.
+    Transform perspective = multiply(translate(cx, cy),
+                                     multiply(Transform{{1.0f, 0, 0, 0, 1.0f, 0, 0, 0.4f / height, 1.0f}},
+                                              translate(-cx, -cy)));
+    float w_center = perspective.m[6] * cx + perspective.m[7] * cy + perspective.m[8];
+    for (float &v : perspective.m) {
+        v /= w_center;
+    }
+
+    // A quarter turn of a square crop maps pixel centers onto pixel
+    // centers and takes the copy path. Nudging it by a fraction of a
+    // degree forces the filtered path for comparison.
+    const int side = std::min(width, height);
+    Buffer<uint8_t> square = in.cropped(0, 0, side).cropped(1, 0, side);
+    Transform quarter_turn = {{0, 1, 0, -1, 0, (float)side, 0, 0, 1}};
+    Transform nearly_quarter_turn = rotate_about(90.01f, side / 2.0f, side / 2.0f, side / 2.0f, side / 2.0f);
+
+    struct WarpCase {
+        const char *name;
+        Buffer<uint8_t> input;
+        Transform transform;
+    } cases[] = {
+        {"rotate 30", in, rotated},
+        {"perspective", in, perspective},
+        {"rotate 90", square, quarter_turn},
+        {"rotate 90.01", square, nearly_quarter_turn},
+    };
+
+    for (const Interpolation &interp : interpolations) {
+        for (const WarpCase &wc : cases) {
+            Buffer<uint8_t> out(wc.input.width(), wc.input.height(), 3);
+            std::string name = std::string("warp/") + interp.name + "/" + wc.name;
+            std::replace(name.begin(), name.end(), ' ', '_');
+            double time = time_warp(name, interp.warp, wc.input, wc.transform, out, &ok);
+            double mp = (double)out.width() * out.height() / 1e6;
+            printf("%-7s  %-12s  %8.3f ms  %7.1f MP/s\n",
+                   interp.name, wc.name, time * 1000, mp / time);
+
+            if (interp.warp == &warp_cubic) {
+                std::string name = std::string("out_") + wc.name + ".png";
+                std::replace(name.begin(), name.end(), ' ', '_');
+                if (!Halide::Tools::save_image(out, name)) {
+                    ok = false;
+                }
+            }
+        }
+    }
+
+    // The exact quarter turn is a transpose and flip of the input.
+    Buffer<uint8_t> turned(side, side, 3);
+    run_warp(&warp_lanczos, square, quarter_turn, turned);
+    turned.for_each_element([&](int x, int y, int c) {
+        if (turned(x, y, c) != square(y, side - 1 - x, c)) {
+            ok = false;
+        }
+    });
+
+    if (!ok) {
+        printf("Warp results are wrong\n");
+        return 1;
+    }
+    printf("Success!\n");
+    return 0;
+}
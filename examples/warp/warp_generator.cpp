@@ -0,0 +1,183 @@
+#include "Halide.h"
+
+#include "resize_kernels.h"
+#include "value_range.h"
+#include "warp_kind.h"
+
+using namespace Halide;
+
+namespace {
+
+// Resamples the input through a projective transform, with the same
+// kernels as the resize app. transform is a row-major 3x3 matrix that
+// maps the center of an output pixel, (x + 0.5, y + 0.5, 1), to
+// homogeneous input coordinates, and kind is warp_kind(transform).
+class Warp : public Halide::Generator<Warp> {
+public:
+    GeneratorParam<InterpolationType> interpolation_type{"interpolation_type", Cubic, {{"box", Box}, {"linear", Linear}, {"cubic", Cubic}, {"lanczos", Lanczos}}};
+
+    // As in the resize app, evaluate cubic and lanczos from a table.
+    GeneratorParam<bool> fast_kernel{"fast_kernel", true};
+
+    Input<Buffer<>> input{"input", 3};
+    Input<float[9]> transform{"transform"};
+    // A WarpKind. It's the only thing the schedule specializes on:
+    // specialize() substitutes a bare parameter compared to a constant
+    // into the definition, which folds the select below to one arm per
+    // branch. Conditions computed from the transform aren't
+    // substituted, and bounds inference would realize the producers of
+    // every arm in every branch.
+    Input<int> kind{"kind"};
+    Output<Buffer<>> output{"output", 3};
+
+    Var x{"x"}, y{"y"}, c{"c"}, k{"k"}, xo{"xo"}, yo{"yo"}, xi{"xi"}, yi{"yi"};
+
+    Func as_float{"as_float"}, as_float_direct{"as_float_direct"}, weight_x{"weight_x"}, weight_y{"weight_y"},
+        weight_sum_x{"weight_sum_x"}, weight_sum_y{"weight_sum_y"}, kernel_table;
+
+    void generate() {
+        Func clamped = BoundaryConditions::repeat_edge(input,
+                                                       {{input.dim(0).min(), input.dim(0).extent()},
+                                                        {input.dim(1).min(), input.dim(1).extent()}});
+        // Work in units of the output type, as the resize app does.
+        // The affine kinds stage this per tile; the perspective one
+        // reads it directly (see schedule()).
+        Expr in_units = cast<float>(clamped(x, y, c)) * (value_range(output.type()) / value_range(input.type()));
+        as_float(x, y, c) = in_units;
+        as_float_direct(x, y, c) = in_units;
+
+        std::vector<Expr> m;
+        for (int i = 0; i < 9; i++) {
+            m.push_back(transform[i]);
+        }
+
+        // Source position of the output pixel center, in the same
+        // convention as the resize app's sourcex/sourcey. Only the
+        // perspective kind divides.
+        Expr xf = x + 0.5f, yf = y + 0.5f;
+        Expr w = select(kind == Perspective, m[6] * xf + m[7] * yf + m[8], 1.0f);
+        Expr u = (m[0] * xf + m[1] * yf + m[2]) / w - 0.5f;
+        Expr v = (m[3] * xf + m[4] * yf + m[5]) / w - 0.5f;
+
+        // Widen the kernel by how far the input moves per output pixel
+        // along either axis, as resize does for downscaling, up to 16x.
+        // This comes from the affine part alone, so strong
+        // foreshortening will alias.
+        const KernelInfo &info = kernel_info(interpolation_type);
+        Expr step_x = sqrt(m[0] * m[0] + m[3] * m[3]) / abs(m[8]);
+        Expr step_y = sqrt(m[1] * m[1] + m[4] * m[4]) / abs(m[8]);
+        Expr kernel_scaling = 1.0f / clamp(max(step_x, step_y), 1.0f, 16.0f);
+        Expr kernel_radius = 0.5f * info.taps / kernel_scaling;
+        Expr kernel_taps = cast<int>(ceil(info.taps / kernel_scaling));
+
+        Expr beginx = cast<int>(ceil(u - kernel_radius));
+        Expr beginy = cast<int>(ceil(v - kernel_radius));
+
+        weight_x(x, y, k) = evaluate_kernel((k + beginx - u) * kernel_scaling);
+        weight_y(x, y, k) = evaluate_kernel((k + beginy - v) * kernel_scaling);
+
+        RDom rk(0, kernel_taps);
+        weight_sum_x(x, y) = sum(weight_x(x, y, rk));
+        weight_sum_y(x, y) = sum(weight_y(x, y, rk));
+
+        RDom r(0, kernel_taps, 0, kernel_taps);
+        auto filter = [&](Func source) {
+            return sum(weight_x(x, y, r.x) * weight_y(x, y, r.y) *
+                       source(r.x + beginx, r.y + beginy, c)) /
+                   (weight_sum_x(x, y) * weight_sum_y(x, y));
+        };
+
+        // Quarter turns with integer offsets land every output pixel
+        // center exactly on an input pixel center, where all four
+        // kernels pass the pixel through unchanged. These are plain
+        // copies.
+        Expr copied = as_float(cast<int>(round(u)), cast<int>(round(v)), c);
+        Expr value = select(kind == QuarterTurn, copied,
+                            kind == Affine, filter(as_float),
+                            filter(as_float_direct));
+
+        // The same tests as warp_kind(), so a kind the transform doesn't
+        // satisfy fails instead of warping wrongly. They only involve
+        // parameters, so they're checked once per call.
+        Expr affine = (m[6] == 0.0f && m[7] == 0.0f && m[8] == 1.0f);
+        Expr integer_offsets = (m[2] == floor(m[2]) && m[5] == floor(m[5]));
+        const int turns[4][4] = {{1, 0, 0, 1}, {0, -1, 1, 0}, {-1, 0, 0, -1}, {0, 1, -1, 0}};
+        Expr quarter_turn = const_false();
+        for (const auto &t : turns) {
+            quarter_turn = quarter_turn || (m[0] == t[0] && m[1] == t[1] && m[3] == t[2] && m[4] == t[3]);
+        }
+        Expr consistent = select(kind == QuarterTurn, affine && integer_offsets && quarter_turn,
+                                 kind == Affine, affine,
+                                 true);
+
+        if (output.type().is_float()) {
+            value = clamp(value, 0.0f, 1.0f);
+        } else {
+            value = saturating_cast(output.type(), value);
+        }
+        output(x, y, c) = require(consistent, value, "warp kind", kind, "doesn't match the transform");
+    }
+
+    Expr evaluate_kernel(Expr x) {
+        const KernelInfo &info = kernel_info(interpolation_type);
+        if (!(fast_kernel && info.tabulate)) {
+            return info.kernel(x);
+        }
+        if (!kernel_table.defined()) {
+            kernel_table = make_kernel_table(info);
+        }
+        return lookup_kernel(kernel_table, info, x);
+    }
+
+    void schedule() {
+        if (kernel_table.defined()) {
+            kernel_table
+                .compute_root()
+                .vectorize(kernel_table.args()[0], 8);
+        }
+
+        const int vector_size = natural_vector_size<float>();
+
+        // Quarter turns compute only the copy. Square tiles keep both
+        // the reads and the writes of the transpose in cache.
+        output.specialize(kind == QuarterTurn)
+            .tile(x, y, xo, yo, xi, yi, 32, 32)
+            .parallel(yo)
+            .vectorize(xi, vector_size);
+        output.specialize(kind == Affine)
+            .tile(x, y, xo, yo, xi, yi, 64, 16)
+            .parallel(yo)
+            .vectorize(xi, vector_size);
+        output.specialize(kind == Perspective)
+            .tile(x, y, xo, yo, xi, yi, 64, 16)
+            .parallel(yo)
+            .vectorize(xi, vector_size);
+        output.specialize_fail("unknown warp kind");
+
+        // The affine kinds stage the window of the input each output
+        // tile gathers from: the tile's footprint plus the kernel
+        // radius. With a perspective divide, w can pass through zero
+        // within the bounds Halide infers for a tile, leaving that
+        // window unbounded, so the perspective kind reads the input
+        // directly through as_float_direct, which is inlined.
+        as_float
+            .compute_at(output, xo)
+            .vectorize(x, vector_size);
+
+        // Every filtered tile computes its own weights, which depend
+        // only on output coordinates.
+        for (Func f : {weight_x, weight_y}) {
+            f.compute_at(output, xo)
+                .reorder(k, x, y)
+                .vectorize(x, vector_size);
+        }
+        for (Func f : {weight_sum_x, weight_sum_y}) {
+            f.compute_at(output, xo)
+                .vectorize(x, vector_size);
+        }
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(Warp, warp)
@@ -0,0 +1,36 @@
+#ifndef WARP_KIND_H
+#define WARP_KIND_H
+
+#include <cmath>
+
+// The kind of transform a warp call gets, passed as the pipeline's kind
+// argument. Each kind has its own branch of the schedule, specialized
+// on that argument alone, so that each computes only what it needs.
+enum WarpKind {
+    // Anything, including a division by w per pixel
+    Perspective,
+    // m[6] == m[7] == 0 and m[8] == 1
+    Affine,
+    // An affine quarter turn (or none) with integer offsets, which maps
+    // every output pixel center onto an input pixel center: a copy.
+    QuarterTurn,
+};
+
+// The cheapest kind that handles transform m. The pipeline fails with
+// an error if it's given a kind its transform doesn't satisfy.
+inline WarpKind warp_kind(const float m[9]) {
+    if (m[6] != 0.0f || m[7] != 0.0f || m[8] != 1.0f) {
+        return Perspective;
+    }
+    const float turns[4][4] = {{1, 0, 0, 1}, {0, -1, 1, 0}, {-1, 0, 0, -1}, {0, 1, -1, 0}};
+    if (m[2] == std::floor(m[2]) && m[5] == std::floor(m[5])) {
+        for (const auto &t : turns) {
+            if (m[0] == t[0] && m[1] == t[1] && m[3] == t[2] && m[4] == t[3]) {
+                return QuarterTurn;
+            }
+        }
+    }
+    return Affine;
+}
+
+#endif  // WARP_KIND_H
@@ -0,0 +1,125 @@
+#include "async_pipeline.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace HalideSupport {
+
+AsyncPipeline::AsyncPipeline(int capacity, int threads) {
+    const int cpus = std::max(1u, std::thread::hardware_concurrency());
+    capacity_ = capacity > 0 ? capacity : cpus;
+    if (threads <= 0) {
+        threads = std::min(cpus, capacity_);
+    }
+    for (int i = 0; i < threads; i++) {
+        threads_.emplace_back([this]() { worker(); });
+    }
+}
+
+AsyncPipeline::~AsyncPipeline() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_.notify_all();
+    for (std::thread &t : threads_) {
+        t.join();
+    }
+}
+
+int AsyncPipeline::in_flight() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return outstanding_;
+}
+
+std::future<int> AsyncPipeline::submit(std::function<int()> call) {
+    auto result = std::make_shared<std::promise<int>>();
+    std::future<int> future = result->get_future();
+    submit(std::move(call), [result](int r) { result->set_value(r); },
+           [result](std::exception_ptr e) { result->set_exception(e); });
+    return future;
+}
+
+void AsyncPipeline::submit(std::function<int()> call, std::function<void(int)> done,
+                           std::function<void(std::exception_ptr)> failed) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_.wait(lock, [this]() { return outstanding_ < capacity(); });
+        outstanding_++;
+    }
+    enqueue({std::move(call), std::move(done), std::move(failed)});
+}
+
+std::future<int> AsyncPipeline::try_submit(std::function<int()> call) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (outstanding_ >= capacity()) {
+            return std::future<int>();
+        }
+        outstanding_++;
+    }
+    auto result = std::make_shared<std::promise<int>>();
+    std::future<int> future = result->get_future();
+    enqueue({std::move(call), [result](int r) { result->set_value(r); },
+             [result](std::exception_ptr e) { result->set_exception(e); }});
+    return future;
+}
+
+void AsyncPipeline::wait_idle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return outstanding_ == 0; });
+}
+
+// The slot was taken by the caller already.
+void AsyncPipeline::enqueue(Call call) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(call));
+    }
+    work_.notify_one();
+}
+
+void AsyncPipeline::worker() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        // Finish what was submitted before stopping.
+        work_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return;
+        }
+        Call call = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+
+        int result = 0;
+        std::exception_ptr error;
+        try {
+            result = call.run();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        // Free the slot before anyone can see the result, so that a
+        // caller who has it can submit again straight away.
+        lock.lock();
+        outstanding_--;
+        space_.notify_one();
+        if (outstanding_ == 0) {
+            idle_.notify_all();
+        }
+        lock.unlock();
+
+        if (!error) {
+            if (call.done) {
+                call.done(result);
+            }
+        } else if (call.failed) {
+            call.failed(error);
+        } else {
+            std::rethrow_exception(error);
+        }
+        lock.lock();
+    }
+}
+
+}  // namespace HalideSupport
@@ -0,0 +1,104 @@
+#ifndef HALIDE_SUPPORT_ASYNC_PIPELINE_H
+#define HALIDE_SUPPORT_ASYNC_PIPELINE_H
+
+// Asynchronous calls of AOT pipelines. The generated entry points
+// block until their output is done; AsyncPipeline runs them on its own
+// threads instead, so the caller can prepare the next request while
+// earlier ones compute, and hands back a future or calls a callback
+// with the pipeline's result.
+//
+//   HalideSupport::AsyncPipeline async(4);
+//   std::future<int> done = async.submit([=] { return halide_blur(in, out); });
+//   ... prepare the next input ...
+//   if (done.get() != 0) { ... }
+//
+// At most capacity() calls are queued or running at once. submit()
+// blocks while that many are outstanding, which pushes back on a
+// producer faster than the pipeline; try_submit() refuses instead.
+// Every call's parallel loops share Halide's one thread pool, so more
+// outstanding calls mostly help to hide the serial parts of a call and
+// the caller's own work between calls. The calls run on threads()
+// threads, by default no more than there are CPUs however deep the
+// queue is.
+//
+// An exception thrown by a call ends up in its future, which rethrows
+// it from get().
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace HalideSupport {
+
+class AsyncPipeline {
+public:
+    // capacity <= 0 means one call per CPU. threads <= 0 means one
+    // per CPU, but no more than capacity, as any beyond that would
+    // never have a call to run.
+    explicit AsyncPipeline(int capacity = 0, int threads = 0);
+    // Waits for every call submitted.
+    ~AsyncPipeline();
+
+    AsyncPipeline(const AsyncPipeline &) = delete;
+    AsyncPipeline &operator=(const AsyncPipeline &) = delete;
+
+    int capacity() const {
+        return capacity_;
+    }
+
+    int threads() const {
+        return (int)threads_.size();
+    }
+
+    // Calls queued or running
+    int in_flight();
+
+    // Run call, waiting first while capacity() calls are outstanding.
+    // The future holds what call returned.
+    std::future<int> submit(std::function<int()> call);
+
+    // The same, calling done(result) on the pipeline's thread when it
+    // finishes instead. done should be quick and mustn't submit to this
+    // AsyncPipeline if it may be full. If call throws, failed gets the
+    // exception instead of done; without failed, the exception ends
+    // the program, as one escaping a std::thread would.
+    void submit(std::function<int()> call, std::function<void(int)> done,
+                std::function<void(std::exception_ptr)> failed = nullptr);
+
+    // Run call unless capacity() calls are outstanding already. Returns
+    // an invalid future if so.
+    std::future<int> try_submit(std::function<int()> call);
+
+    // Wait until every call submitted so far has finished. A call's slot
+    // is freed before its future is ready or its done callback runs, so
+    // those may follow just after this returns.
+    void wait_idle();
+
+private:
+    struct Call {
+        std::function<int()> run;
+        std::function<void(int)> done;
+        std::function<void(std::exception_ptr)> failed;
+    };
+
+    void enqueue(Call call);
+    void worker();
+
+    int capacity_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable work_, space_, idle_;
+    std::deque<Call> queue_;
+    // Queued plus running
+    int outstanding_ = 0;
+    bool stop_ = false;
+};
+
+}  // namespace HalideSupport
+
+#endif  // HALIDE_SUPPORT_ASYNC_PIPELINE_H
@@ -0,0 +1,74 @@
+#ifndef HALIDE_SUPPORT_CANCELLATION_H
+#define HALIDE_SUPPORT_CANCELLATION_H
+
+// Cooperative cancellation of pipeline calls. A Cancellation is checked
+// before every iteration of the call's parallel loops (a strip or tile
+// of the output, depending on the schedule), through the ThreadBudget
+// the call gets as its user_context (see thread_budget.h). Once it has
+// been cancelled, or its deadline has passed, no more iterations start
+// and the call returns cancelled_error. The ones already running finish
+// first, so a call stops within about one strip's time, and its output
+// is partly written. A schedule without parallel loops (or a GPU one)
+// is never checked, nor is a pipeline generated without user_context,
+// which has no way to receive the ThreadBudget. Of the examples, only
+// halide_blur_budget has it.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+namespace HalideSupport {
+
+// What a cancelled call returns. Halide's own error codes are small
+// negative numbers, so this can't be mistaken for one of them.
+const int cancelled_error = -1000;
+
+class Cancellation {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Stop the calls using this as soon as possible. Any thread may
+    // call this at any time.
+    void cancel() {
+        cancelled_ = true;
+    }
+
+    // Stop them once Clock::now() passes deadline.
+    void set_deadline(Clock::time_point deadline) {
+        deadline_ = deadline.time_since_epoch().count();
+    }
+
+    // Clear the flag and the deadline, to use this for another call.
+    void reset() {
+        cancelled_ = false;
+        deadline_ = std::numeric_limits<Clock::rep>::max();
+        checks_ = 0;
+    }
+
+    // Whether an iteration about to start should be skipped instead
+    bool should_stop() {
+        checks_.fetch_add(1, std::memory_order_relaxed);
+        if (cancelled_.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        Clock::rep deadline = deadline_.load(std::memory_order_relaxed);
+        return deadline != std::numeric_limits<Clock::rep>::max() &&
+               Clock::now().time_since_epoch().count() >= deadline;
+    }
+
+    // How many times should_stop() was asked since the last reset(),
+    // i.e. the iterations the calls started or skipped
+    int checks() const {
+        return checks_;
+    }
+
+private:
+    std::atomic<bool> cancelled_{false};
+    std::atomic<Clock::rep> deadline_{std::numeric_limits<Clock::rep>::max()};
+    std::atomic<int> checks_{0};
+};
+
+}  // namespace HalideSupport
+
+#endif  // HALIDE_SUPPORT_CANCELLATION_H
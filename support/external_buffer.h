@@ -0,0 +1,93 @@
+#ifndef HALIDE_SUPPORT_EXTERNAL_BUFFER_H
+#define HALIDE_SUPPORT_EXTERNAL_BUFFER_H
+
+// Halide buffers over frames that live in someone else's memory, such
+// as a capture library's, without copying them. Such frames often have
+// rows padded to some pitch, and may be stored bottom-up; wrap_frame
+// describes both with strides, so the pipeline reads the frame where
+// it is:
+//
+//   HalideSupport::FrameLayout layout;
+//   layout.width = 1920;
+//   layout.height = 1080;
+//   layout.channels = 3;
+//   layout.row_stride = pitch;     // bytes, padding included
+//   layout.bottom_up = true;
+//   auto in = HalideSupport::wrap_frame<uint8_t>(frame_data, layout);
+//   resize_cubic_uint8_float32(in, 0.5f, 0.5f, 0, out);
+//
+// The buffer doesn't own the memory, which has to outlive it. The
+// pipelines must not constrain the strides the frame has: by default
+// Halide only requires dim(0) to be dense, which interleaved frames
+// break (see the specializations in the blur and resize generators).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include "HalideBuffer.h"
+
+namespace HalideSupport {
+
+struct FrameLayout {
+    int width = 0, height = 0;
+    int channels = 1;
+    // The channels of a pixel next to each other (RGBRGB...), rather
+    // than one plane per channel
+    bool interleaved = true;
+    // Bytes from the start of one row in memory to the next; 0 if the
+    // rows aren't padded
+    ptrdiff_t row_stride = 0;
+    // Bytes from one plane to the next; 0 if they follow each other
+    // directly. Only for planar frames.
+    ptrdiff_t plane_stride = 0;
+    // The first row in memory is the bottom of the image
+    bool bottom_up = false;
+};
+
+// A width x height x channels buffer over the frame at data. x runs
+// left to right and y top to bottom, whatever order the rows are
+// stored in. Returns an undefined buffer if the strides aren't
+// multiples of sizeof(T), or are too small to hold a row or a plane.
+template<typename T>
+Halide::Runtime::Buffer<T> wrap_frame(void *data, const FrameLayout &frame) {
+    const ptrdiff_t elem = sizeof(T);
+    const ptrdiff_t pixel = frame.interleaved ? frame.channels * elem : elem;
+    const ptrdiff_t row = frame.row_stride ? frame.row_stride : frame.width * pixel;
+    const ptrdiff_t plane = frame.interleaved ? elem : (frame.plane_stride ? frame.plane_stride : row * frame.height);
+    if (row % elem || plane % elem || row < frame.width * pixel ||
+        (!frame.interleaved && frame.channels > 1 && plane < row * frame.height)) {
+        return Halide::Runtime::Buffer<T>();
+    }
+
+    halide_dimension_t shape[3] = {
+        {0, frame.width, (int32_t)(pixel / elem)},
+        {0, frame.height, (int32_t)((frame.bottom_up ? -row : row) / elem)},
+        {0, frame.channels, (int32_t)(plane / elem)}};
+    // The host pointer is pixel (0, 0), which for a bottom-up frame is
+    // the last row in memory.
+    uint8_t *top = (uint8_t *)data + (frame.bottom_up ? (frame.height - 1) * row : 0);
+    return Halide::Runtime::Buffer<T>((T *)top, 3, shape);
+}
+
+// The largest power of two, up to max_alignment, that the start of
+// every row and plane of buf is a multiple of (in bytes). Padding rows
+// to a pitch is what keeps them aligned; a pipeline built with
+// set_host_alignment(n) and its row stride constrained to match may
+// only be given buffers for which this is at least n.
+inline int row_alignment(const halide_buffer_t &buf, int max_alignment = 4096) {
+    uintptr_t bits = (uintptr_t)buf.host | (uintptr_t)max_alignment;
+    const long row_span = std::labs((long)buf.dim[0].stride) * buf.dim[0].extent;
+    for (int i = 1; i < buf.dimensions; i++) {
+        // Interleaved channels step within a pixel, not between rows.
+        const long stride = std::labs((long)buf.dim[i].stride);
+        if (stride >= row_span) {
+            bits |= (uintptr_t)(stride * buf.type.bytes());
+        }
+    }
+    return (int)(bits & (~bits + 1));
+}
+
+}  // namespace HalideSupport
+
+#endif  // HALIDE_SUPPORT_EXTERNAL_BUFFER_H
@@ -0,0 +1,193 @@
+#include "huge_pages.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#include "HalideRuntime.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace HalideSupport {
+
+namespace {
+
+const size_t alignment = 128;
+
+HugePages mode = HugePages::Off;
+
+// The mappings we made, by the pointer handed out, so free can tell
+// them from the ordinary allocations.
+struct Mapping {
+    void *base;
+    size_t size;
+    // What was asked for, rounded up to whole huge pages
+    size_t bytes;
+};
+std::mutex mutex;
+std::unordered_map<void *, Mapping> mappings;
+size_t requested = 0;
+
+bool installed = false;
+
+size_t round_up(size_t x, size_t to) {
+    return (x + to - 1) / to * to;
+}
+
+void *map_huge(size_t size, HugePages how, Mapping *mapping) {
+#ifdef __linux__
+    size = round_up(size, huge_page_size);
+#ifdef MAP_HUGETLB
+    if (how == HugePages::Reserved) {
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            *mapping = {p, size, size};
+            return p;
+        }
+    }
+#endif
+    // Over-allocate by one huge page so the start can be aligned to one;
+    // transparent huge pages only back aligned 2 MiB ranges.
+    size_t padded = size + huge_page_size;
+    void *base = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+    void *p = (void *)round_up((size_t)base, huge_page_size);
+#ifdef MADV_HUGEPAGE
+    madvise(p, size, MADV_HUGEPAGE);
+#endif
+    *mapping = {base, padded, size};
+    return p;
+#else
+    return nullptr;
+#endif
+}
+
+void *halide_huge_page_malloc(void *, size_t size) {
+    return huge_page_malloc(size);
+}
+
+void halide_huge_page_free(void *, void *ptr) {
+    huge_page_free(ptr);
+}
+
+}  // namespace
+
+bool parse_huge_pages(const char *name, HugePages *result) {
+    for (HugePages m : {HugePages::Off, HugePages::Madvise, HugePages::Reserved}) {
+        if (strcmp(name, huge_pages_name(m)) == 0) {
+            *result = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *huge_pages_name(HugePages m) {
+    switch (m) {
+    case HugePages::Madvise:
+        return "madvise";
+    case HugePages::Reserved:
+        return "hugetlb";
+    default:
+        return "off";
+    }
+}
+
+void set_huge_pages(HugePages m) {
+    std::lock_guard<std::mutex> lock(mutex);
+    mode = m;
+}
+
+HugePages huge_pages() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return mode;
+}
+
+void *huge_page_malloc(size_t size) {
+    HugePages how = huge_pages();
+    if (how != HugePages::Off && size >= huge_page_threshold) {
+        Mapping mapping;
+        if (void *p = map_huge(size, how, &mapping)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            mappings[p] = mapping;
+            requested += mapping.bytes;
+            return p;
+        }
+    }
+    // Like halide_malloc: aligned, and never null for size 0
+    void *p = nullptr;
+    if (posix_memalign(&p, alignment, round_up(size ? size : 1, alignment)) != 0) {
+        return nullptr;
+    }
+    return p;
+}
+
+void huge_page_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    Mapping mapping = {nullptr, 0, 0};
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = mappings.find(ptr);
+        if (it != mappings.end()) {
+            mapping = it->second;
+            requested -= mapping.bytes;
+            mappings.erase(it);
+        }
+    }
+    if (mapping.base) {
+#ifdef __linux__
+        munmap(mapping.base, mapping.size);
+#endif
+    } else {
+        free(ptr);
+    }
+}
+
+void use_huge_pages(HugePages m) {
+    set_huge_pages(m);
+    // Once installed the handlers stay: the pipelines may still hold
+    // memory from them, which only huge_page_free can release. With Off
+    // they hand out ordinary memory.
+    std::lock_guard<std::mutex> lock(mutex);
+    if (m != HugePages::Off && !installed) {
+        halide_set_custom_malloc(&halide_huge_page_malloc);
+        halide_set_custom_free(&halide_huge_page_free);
+        installed = true;
+    }
+}
+
+size_t huge_page_bytes_requested() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return requested;
+}
+
+long long huge_page_bytes_backed() {
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f) {
+        return -1;
+    }
+    // Transparent huge pages show up as AnonHugePages, the reserved
+    // pool as Private_Hugetlb; both in kB.
+    long long total = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        long long kb = 0;
+        if (sscanf(line, "AnonHugePages: %lld kB", &kb) == 1 ||
+            sscanf(line, "Private_Hugetlb: %lld kB", &kb) == 1) {
+            total += kb * 1024;
+        }
+    }
+    fclose(f);
+    return total;
+}
+
+}  // namespace HalideSupport
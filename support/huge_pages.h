@@ -0,0 +1,87 @@
+#ifndef HALIDE_SUPPORT_HUGE_PAGES_H
+#define HALIDE_SUPPORT_HUGE_PAGES_H
+
+// Backing large buffers with 2 MiB pages, so passes that walk down
+// columns of a big frame touch a few hundred TLB entries instead of
+// tens of thousands. Covers both the Runtime::Buffers a harness
+// allocates (through allocate_huge below) and, once use_huge_pages()
+// has been called, the pipelines' own heap allocations, which go
+// through halide_malloc.
+//
+// Only allocations of at least huge_page_threshold bytes are affected;
+// smaller ones, and everything on systems without huge pages, get
+// ordinary aligned memory. Linux only.
+
+#include <cstddef>
+
+#include "HalideBuffer.h"
+
+namespace HalideSupport {
+
+enum class HugePages {
+    // Ordinary pages
+    Off,
+    // Transparent huge pages, asked for with madvise(MADV_HUGEPAGE).
+    // Needs /sys/kernel/mm/transparent_hugepage/enabled to be madvise
+    // or always.
+    Madvise,
+    // Pages from the reserved pool (MAP_HUGETLB), see
+    // /proc/sys/vm/nr_hugepages. Falls back to Madvise when the pool
+    // runs out.
+    Reserved,
+};
+
+const size_t huge_page_size = 2 * 1024 * 1024;
+const size_t huge_page_threshold = huge_page_size;
+
+// "off", "madvise" or "hugetlb"; false if name is none of them.
+bool parse_huge_pages(const char *name, HugePages *mode);
+const char *huge_pages_name(HugePages mode);
+
+// The mode huge_page_malloc uses. Off until set.
+void set_huge_pages(HugePages mode);
+HugePages huge_pages();
+
+// Allocation functions in the shape Runtime::Buffer::allocate and
+// Buffer::copy take. Memory is aligned to 128 bytes, like
+// halide_malloc's, and to huge_page_size when it's mapped.
+void *huge_page_malloc(size_t size);
+void huge_page_free(void *ptr);
+
+// set_huge_pages(mode), and route the pipelines' halide_malloc and
+// halide_free through the functions above. Call it while no pipeline
+// is running: they can't free what Halide's own malloc handed out.
+void use_huge_pages(HugePages mode);
+
+// Bytes currently allocated in mappings that asked for huge pages, and
+// how much of the whole process the kernel actually backs with huge
+// pages (from /proc/self/smaps_rollup, or -1 if that can't be read).
+size_t huge_page_bytes_requested();
+long long huge_page_bytes_backed();
+
+// A buffer of the given shape allocated by huge_page_malloc, e.g.
+// allocate_huge<uint16_t>(6408, 4802).
+template<typename T, typename... Args>
+Halide::Runtime::Buffer<T> allocate_huge(int first, Args... rest) {
+    Halide::Runtime::Buffer<T> buf(nullptr, first, rest...);
+    buf.allocate(&huge_page_malloc, &huge_page_free);
+    return buf;
+}
+
+// The same for a buffer whose type is only known at runtime
+template<typename... Args>
+Halide::Runtime::Buffer<> allocate_huge(halide_type_t type, int first, Args... rest) {
+    Halide::Runtime::Buffer<> buf(type, nullptr, first, rest...);
+    buf.allocate(&huge_page_malloc, &huge_page_free);
+    return buf;
+}
+
+// A copy of im, with the same layout, in memory from huge_page_malloc
+template<typename T>
+Halide::Runtime::Buffer<T> copy_to_huge(const Halide::Runtime::Buffer<T> &im) {
+    return im.copy(&huge_page_malloc, &huge_page_free);
+}
+
+}  // namespace HalideSupport
+
+#endif  // HALIDE_SUPPORT_HUGE_PAGES_H
@@ -0,0 +1,155 @@
+#include "jit_cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef JIT_CACHE_LINKER
+#define JIT_CACHE_LINKER "c++"
+#endif
+
+namespace HalideSupport {
+
+namespace {
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// FNV-1a, which unlike std::hash is the same in every build
+struct Hash {
+    uint64_t value = 14695981039346656037ull;
+
+    void add(const void *data, size_t size) {
+        const unsigned char *bytes = (const unsigned char *)data;
+        for (size_t i = 0; i < size; i++) {
+            value = (value ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+    void add(const std::string &s) {
+        add(s.data(), s.size());
+        add("\0", 1);
+    }
+};
+
+void make_directories(const std::string &path) {
+    for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1)) {
+        mkdir(path.substr(0, pos).c_str(), 0755);
+    }
+    mkdir(path.c_str(), 0755);
+}
+
+bool file_exists(const std::string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+std::string quote(const std::string &s) {
+    std::string quoted = "'";
+    for (char c : s) {
+        quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    }
+    return quoted + "'";
+}
+
+}  // namespace
+
+std::string JITCache::default_dir() {
+    if (const char *dir = getenv("HL_JIT_CACHE_DIR")) {
+        return dir;
+    }
+    const char *home = getenv("HOME");
+    return std::string(home ? home : "/tmp") + "/.cache/halide-jit";
+}
+
+JITCache::JITCache(const std::string &dir)
+    : dir_(dir) {
+    make_directories(dir_);
+}
+
+CachedPipeline JITCache::compile(const Halide::Pipeline &pipeline, const std::vector<Halide::Argument> &args,
+                                 const std::string &name, const Halide::Target &target) {
+    // The lowered module holds the whole Func graph and its schedule.
+    auto start = std::chrono::steady_clock::now();
+    Halide::Module module = pipeline.compile_to_module(args, name, target);
+    double lower = seconds_since(start);
+    stats_.lower += lower;
+
+    std::ostringstream text;
+    text << module;
+    Hash hash;
+    hash.add(text.str());
+    hash.add(target.to_string());
+#ifdef HALIDE_VERSION_MAJOR
+    // The same module can generate different code in another release.
+    hash.add(std::to_string(HALIDE_VERSION_MAJOR) + "." + std::to_string(HALIDE_VERSION_MINOR) + "." +
+             std::to_string(HALIDE_VERSION_PATCH));
+#endif
+    // Buffers the pipeline uses directly become constants in the object.
+    for (const Halide::Buffer<> &buf : module.buffers()) {
+        hash.add(buf.data(), buf.size_in_bytes());
+    }
+    char key[32];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash.value);
+    const std::string library = dir_ + "/" + name + "-" + key + ".so";
+
+    bool hit = file_exists(library);
+    double compile = 0;
+    char buf[256];
+    if (!hit) {
+        // Build under a name of our own and rename, so concurrent
+        // processes never load a half-written library.
+        start = std::chrono::steady_clock::now();
+        const std::string tmp = library + "." + std::to_string(getpid());
+        module.compile({{Halide::OutputFileType::object, tmp + ".o"}});
+        const char *linker = getenv("HL_JIT_CACHE_LINKER");
+        std::string command = std::string(linker ? linker : JIT_CACHE_LINKER) +
+                              " -shared -o " + quote(tmp) + " " + quote(tmp + ".o") + " -lpthread -ldl";
+        bool linked = system(command.c_str()) == 0;
+        remove((tmp + ".o").c_str());
+        if (!linked || rename(tmp.c_str(), library.c_str()) != 0) {
+            remove(tmp.c_str());
+            stats_.failures++;
+            snprintf(buf, sizeof(buf), "JIT cache: failed to link %s", name.c_str());
+            report_ = buf;
+            return CachedPipeline();
+        }
+        compile = seconds_since(start);
+        stats_.compile += compile;
+    }
+
+    start = std::chrono::steady_clock::now();
+    CachedPipeline result;
+    void *handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle) {
+        result.library_ = std::shared_ptr<void>(handle, [](void *h) { dlclose(h); });
+        result.fn_ = (int (*)(void **))dlsym(handle, (name + "_argv").c_str());
+    }
+    double load = seconds_since(start);
+    stats_.load += load;
+    if (!result.defined()) {
+        stats_.failures++;
+        snprintf(buf, sizeof(buf), "JIT cache: failed to load %s: %s", library.c_str(), handle ? "no entry point" : dlerror());
+        report_ = buf;
+        return CachedPipeline();
+    }
+
+    if (hit) {
+        stats_.hits++;
+        snprintf(buf, sizeof(buf), "JIT cache: hit %s (lower %.1f ms, load %.1f ms)",
+                 name.c_str(), lower * 1e3, load * 1e3);
+    } else {
+        stats_.misses++;
+        snprintf(buf, sizeof(buf), "JIT cache: miss %s (lower %.1f ms, compile %.1f ms, load %.1f ms)",
+                 name.c_str(), lower * 1e3, compile * 1e3, load * 1e3);
+    }
+    report_ = buf;
+    return result;
+}
+
+}  // namespace HalideSupport
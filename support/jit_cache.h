@@ -0,0 +1,87 @@
+#ifndef HALIDE_SUPPORT_JIT_CACHE_H
+#define HALIDE_SUPPORT_JIT_CACHE_H
+
+// An on-disk cache for pipelines that would otherwise be JIT-compiled
+// at every start. A pipeline is lowered (cheap), and the lowered
+// module, the target and the contents of any buffers it embeds are
+// hashed into the key. On a miss the module goes through LLVM into an
+// object file, is linked into a shared library in the cache directory,
+// and loaded; on a hit the library is just loaded, skipping LLVM.
+//
+//   HalideSupport::JITCache cache;  // $HL_JIT_CACHE_DIR, or ~/.cache/halide-jit
+//   HalideSupport::CachedPipeline p = cache.compile(f, {input_param}, "blur", target);
+//   p({input.raw_buffer(), output.raw_buffer()});
+//
+// Each library carries its own copy of the Halide runtime, so handlers
+// set with halide_set_custom_* in the process don't apply to it.
+// Linking uses the C++ compiler the cache was built with, or
+// $HL_JIT_CACHE_LINKER. POSIX only.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Halide.h"
+
+namespace HalideSupport {
+
+// A loaded pipeline. Call it with one pointer per argument, in the
+// order given to JITCache::compile and then the outputs: a
+// halide_buffer_t * for buffers, a pointer to the value for scalars.
+class CachedPipeline {
+public:
+    CachedPipeline() = default;
+
+    bool defined() const {
+        return fn_ != nullptr;
+    }
+    int operator()(std::vector<void *> args) const {
+        return fn_(args.data());
+    }
+
+private:
+    friend class JITCache;
+    std::shared_ptr<void> library_;
+    int (*fn_)(void **) = nullptr;
+};
+
+class JITCache {
+public:
+    struct Stats {
+        int hits = 0, misses = 0, failures = 0;
+        // Seconds spent lowering (every time), in LLVM and the linker
+        // (misses), and loading libraries
+        double lower = 0, compile = 0, load = 0;
+    };
+
+    // The cache directory is created if needed.
+    explicit JITCache(const std::string &dir = default_dir());
+
+    // $HL_JIT_CACHE_DIR, or ~/.cache/halide-jit
+    static std::string default_dir();
+
+    // The pipeline computing output from args, from the cache or newly
+    // compiled into it. Undefined if compiling or loading fails, in
+    // which case the caller should fall back to compile_jit.
+    CachedPipeline compile(const Halide::Pipeline &pipeline, const std::vector<Halide::Argument> &args,
+                           const std::string &name, const Halide::Target &target);
+
+    const Stats &stats() const {
+        return stats_;
+    }
+
+    // e.g. "JIT cache: hit curved (lower 80.1 ms, load 1.2 ms)", for the
+    // last call of compile
+    const std::string &last_report() const {
+        return report_;
+    }
+
+private:
+    std::string dir_;
+    Stats stats_;
+    std::string report_;
+};
+
+}  // namespace HalideSupport
+
+#endif  // HALIDE_SUPPORT_JIT_CACHE_H
@@ -0,0 +1,396 @@
+#include "numa.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "HalideRuntime.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace HalideSupport {
+
+namespace {
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+std::vector<int> parse_cpu_list(const std::string &list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        std::string range = list.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        int first = 0, last = 0;
+        int n = sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (n >= 1) {
+            for (int cpu = first; cpu <= (n == 2 ? last : first); cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++) {
+            cpus.push_back((int)cpu);
+        }
+    }
+    return cpus;
+}
+
+// Which simulated node first wrote each page, see first_touch
+std::mutex touched_mutex;
+std::map<uintptr_t, int> touched_pages;
+
+size_t page_size() {
+#ifdef __linux__
+    return (size_t)sysconf(_SC_PAGESIZE);
+#else
+    return 4096;
+#endif
+}
+
+thread_local bool in_pool_task = false;
+NumaPool *installed_pool = nullptr;
+
+}  // namespace
+
+NumaTopology numa_topology(int simulated_nodes) {
+    if (const char *env = getenv("HL_NUMA_NODES")) {
+        simulated_nodes = atoi(env);
+    }
+
+    NumaTopology topology;
+    std::vector<int> allowed = allowed_cpus();
+#ifdef __linux__
+    const std::string root = "/sys/devices/system/node/";
+    std::map<int, std::vector<int>> nodes;
+    if (DIR *dir = opendir(root.c_str())) {
+        while (dirent *entry = readdir(dir)) {
+            int id;
+            if (sscanf(entry->d_name, "node%d", &id) != 1) {
+                continue;
+            }
+            char line[4096] = "";
+            if (FILE *f = fopen((root + entry->d_name + "/cpulist").c_str(), "r")) {
+                if (!fgets(line, sizeof(line), f)) {
+                    line[0] = 0;
+                }
+                fclose(f);
+            }
+            for (int cpu : parse_cpu_list(line)) {
+                if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+                    nodes[id].push_back(cpu);
+                }
+            }
+        }
+        closedir(dir);
+    }
+    if (nodes.size() > 1) {
+        for (const auto &node : nodes) {
+            topology.ids.push_back(node.first);
+            topology.nodes.push_back(node.second);
+        }
+        return topology;
+    }
+#endif
+
+    // One node: split its CPUs, or share them round robin if there are
+    // fewer CPUs than nodes, so every node has at least one.
+    const int count = std::max(1, simulated_nodes);
+    const int cpus = (int)allowed.size();
+    topology.simulated = count > 1;
+    topology.nodes.resize(count);
+    for (int node = 0; node < count; node++) {
+        topology.ids.push_back(node);
+        int begin = node_range_begin(cpus, node, count), end = node_range_begin(cpus, node + 1, count);
+        if (begin == end) {
+            topology.nodes[node].push_back(allowed[node % cpus]);
+        }
+        for (int i = begin; i < end; i++) {
+            topology.nodes[node].push_back(allowed[i]);
+        }
+    }
+    return topology;
+}
+
+bool pin_thread(const std::vector<int> &cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+int node_range_begin(int n, int node, int nodes) {
+    return (int)((int64_t)n * node / nodes);
+}
+
+struct NumaPool::Job {
+    std::function<int(int)> body;
+    int size;
+    bool steal;
+    // Per node: the next task to take and the end of its range
+    std::unique_ptr<std::atomic<int>[]> next;
+    std::vector<int> end;
+    std::vector<int> *task_nodes;
+    std::atomic<int> done{0}, result{0};
+    // Workers inside run_tasks, guarded by the pool's mutex
+    int users = 0;
+};
+
+NumaPool::NumaPool(const NumaTopology &topology)
+    : topology_(topology) {
+    for (int node = 0; node < (int)topology_.nodes.size(); node++) {
+        for (size_t i = 0; i < topology_.nodes[node].size(); i++) {
+            threads_.emplace_back([this, node]() { worker(node); });
+        }
+    }
+}
+
+NumaPool::~NumaPool() {
+    uninstall();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &t : threads_) {
+        t.join();
+    }
+}
+
+void NumaPool::install() {
+    installed_pool = this;
+    halide_set_custom_do_par_for(&NumaPool::do_par_for);
+}
+
+void NumaPool::uninstall() {
+    if (installed_pool == this) {
+        halide_set_custom_do_par_for(&halide_default_do_par_for);
+        installed_pool = nullptr;
+    }
+}
+
+int NumaPool::do_par_for(void *user_context, int (*task)(void *, int, uint8_t *), int min, int size, uint8_t *closure) {
+    NumaPool *pool = installed_pool;
+    if (in_pool_task || !pool) {
+        for (int i = 0; i < size; i++) {
+            if (int result = task(user_context, min + i, closure)) {
+                return result;
+            }
+        }
+        return 0;
+    }
+    return pool->run(size, true, true, [&](int i) { return task(user_context, min + i, closure); });
+}
+
+void NumaPool::run_on_nodes(int n, const std::function<void(int node, int begin, int end)> &f) {
+    const int nodes = (int)topology_.nodes.size();
+    run(nodes, false, false, [&](int node) {
+        f(node, node_range_begin(n, node, nodes), node_range_begin(n, node + 1, nodes));
+        return 0;
+    });
+}
+
+int NumaPool::run(int size, bool steal, bool record, const std::function<int(int)> &body) {
+    if (size <= 0) {
+        return 0;
+    }
+    // One loop at a time; loops from other threads queue up here.
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+
+    const int nodes = (int)topology_.nodes.size();
+    std::vector<int> task_nodes(record ? size : 0);
+    Job job;
+    job.body = body;
+    job.size = size;
+    // run_on_nodes has one task per node, which only that node may take.
+    job.steal = steal;
+    job.next.reset(new std::atomic<int>[nodes]);
+    for (int node = 0; node < nodes; node++) {
+        job.next[node] = steal ? node_range_begin(size, node, nodes) : node;
+        job.end.push_back(steal ? node_range_begin(size, node + 1, nodes) : node + 1);
+    }
+    job.task_nodes = record ? &task_nodes : nullptr;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_ = &job;
+    generation_++;
+    wake_.notify_all();
+    done_.wait(lock, [&]() { return job.done == job.size && job.users == 0; });
+    job_ = nullptr;
+    if (record) {
+        history_.push_back(task_nodes);
+    }
+    return job.result;
+}
+
+void NumaPool::worker(int node) {
+    pin_thread(topology_.nodes[node]);
+    in_pool_task = true;
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [&]() { return stop_ || (job_ && generation_ != seen); });
+        if (stop_) {
+            return;
+        }
+        seen = generation_;
+        Job *job = job_;
+        job->users++;
+        lock.unlock();
+        run_tasks(job, node);
+        lock.lock();
+        if (--job->users == 0) {
+            done_.notify_all();
+        }
+    }
+}
+
+void NumaPool::run_tasks(Job *job, int node) {
+    const int nodes = (int)job->end.size();
+    for (int k = 0; k < (job->steal ? nodes : 1); k++) {
+        const int from = (node + k) % nodes;
+        while (true) {
+            const int i = job->next[from]++;
+            if (i >= job->end[from]) {
+                break;
+            }
+            if (job->task_nodes) {
+                (*job->task_nodes)[i] = node;
+            }
+            int result = job->body(i);
+            if (result) {
+                int expected = 0;
+                job->result.compare_exchange_strong(expected, result);
+            }
+            if (++job->done == job->size) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.notify_all();
+            }
+        }
+    }
+}
+
+std::vector<std::vector<int>> NumaPool::history() {
+    std::lock_guard<std::mutex> lock(run_mutex_);
+    return history_;
+}
+
+void NumaPool::clear_history() {
+    std::lock_guard<std::mutex> lock(run_mutex_);
+    history_.clear();
+}
+
+void first_touch(NumaPool &pool, Halide::Runtime::Buffer<> buf,
+                 const std::function<void(Halide::Runtime::Buffer<> rows)> &init) {
+    const int rows = buf.dim(1).extent();
+    const bool simulated = pool.topology().simulated;
+    pool.run_on_nodes(rows, [&](int node, int begin, int end) {
+        if (begin == end) {
+            return;
+        }
+        Halide::Runtime::Buffer<> crop = buf.cropped(1, buf.dim(1).min() + begin, end - begin);
+        init(crop);
+        if (!simulated) {
+            return;
+        }
+        // Note the pages of every row of the crop, in all the other
+        // dimensions too (e.g. each channel of a planar image).
+        const uintptr_t page = page_size();
+        std::lock_guard<std::mutex> lock(touched_mutex);
+        crop.sliced(0, crop.dim(0).min()).for_each_element([&](const int *pos) {
+            std::vector<int> coords(crop.dimensions());
+            coords[0] = crop.dim(0).min();
+            for (int d = 1; d < crop.dimensions(); d++) {
+                coords[d] = pos[d - 1];
+            }
+            uintptr_t first = (uintptr_t)crop.address_of(coords.data());
+            coords[0] = crop.dim(0).max();
+            uintptr_t last = (uintptr_t)crop.address_of(coords.data());
+            for (uintptr_t p = first / page * page; p <= last; p += page) {
+                touched_pages.insert({p, node});
+            }
+        });
+    });
+}
+
+int home_node(const NumaTopology &topology, const void *p) {
+    const uintptr_t page = (uintptr_t)p / page_size() * page_size();
+    if (topology.simulated || topology.nodes.size() < 2) {
+        std::lock_guard<std::mutex> lock(touched_mutex);
+        auto it = touched_pages.find(page);
+        return it == touched_pages.end() ? 0 : it->second;
+    }
+#if defined(__linux__) && defined(SYS_move_pages)
+    // move_pages without target nodes reports where each page is.
+    void *pages[] = {(void *)page};
+    int status = -1;
+    if (syscall(SYS_move_pages, 0, 1, pages, nullptr, &status, 0) == 0 && status >= 0) {
+        auto it = std::find(topology.ids.begin(), topology.ids.end(), status);
+        return it == topology.ids.end() ? -1 : (int)(it - topology.ids.begin());
+    }
+#endif
+    return -1;
+}
+
+std::vector<int> row_home_nodes(const NumaTopology &topology, const Halide::Runtime::Buffer<> &buf) {
+    std::vector<int> nodes;
+    std::vector<int> coords(buf.dimensions());
+    for (int d = 0; d < buf.dimensions(); d++) {
+        coords[d] = buf.dim(d).min();
+    }
+    for (int y = buf.dim(1).min(); y <= buf.dim(1).max(); y++) {
+        coords[1] = y;
+        nodes.push_back(home_node(topology, buf.address_of(coords.data())));
+    }
+    return nodes;
+}
+
+double node_local_ratio(const std::vector<int> &task_nodes, const std::vector<int> &row_nodes) {
+    const int tasks = (int)task_nodes.size(), rows = (int)row_nodes.size();
+    if (tasks == 0 || rows == 0) {
+        return 0;
+    }
+    int local = 0;
+    for (int y = 0; y < rows; y++) {
+        const int task = std::min(tasks - 1, (int)((int64_t)y * tasks / rows));
+        local += row_nodes[y] == task_nodes[task];
+    }
+    return (double)local / rows;
+}
+
+}  // namespace HalideSupport
@@ -0,0 +1,120 @@
+#ifndef HALIDE_SUPPORT_NUMA_H
+#define HALIDE_SUPPORT_NUMA_H
+
+// NUMA placement for the pipelines' parallel loops. NumaPool replaces
+// Halide's thread pool with threads pinned to each node, and splits
+// every parallel loop into one contiguous range of strips per node, so
+// the strips of node k always run on node k. first_touch() initialises
+// a buffer with the same split, so the rows a node's strips read are
+// placed in that node's memory by the kernel's first-touch policy.
+// node_local_ratio() then reports how many of the rows the strips read
+// were local to the thread that read them.
+//
+// On a machine with one node, NumaTopology can simulate several by
+// splitting the CPUs into sets. Memory isn't really split then, so
+// first_touch() remembers which node wrote each page and home_node()
+// answers from that; pages it hasn't seen count as node 0's, where an
+// initialisation on the main thread would leave them. Linux only;
+// elsewhere everything is one node.
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "HalideBuffer.h"
+
+namespace HalideSupport {
+
+struct NumaTopology {
+    // The CPUs of each node that this process may run on
+    std::vector<std::vector<int>> nodes;
+    // The kernel's number for each node, when not simulated
+    std::vector<int> ids;
+    bool simulated = false;
+};
+
+// The machine's NUMA nodes. With only one and simulated_nodes > 1, that
+// many nodes made from the allowed CPUs, split into contiguous sets.
+// HL_NUMA_NODES in the environment overrides simulated_nodes.
+NumaTopology numa_topology(int simulated_nodes = 0);
+
+// Pin the calling thread to cpus. Returns false if that isn't possible.
+bool pin_thread(const std::vector<int> &cpus);
+
+// The first of n items in node's range, when they're split into
+// contiguous ranges over nodes the way NumaPool splits parallel loops.
+// The range ends where node + 1's begins.
+int node_range_begin(int n, int node, int nodes);
+
+class NumaPool {
+public:
+    // Starts one thread per CPU of every node, pinned to that node.
+    explicit NumaPool(const NumaTopology &topology);
+    ~NumaPool();
+
+    NumaPool(const NumaPool &) = delete;
+    NumaPool &operator=(const NumaPool &) = delete;
+
+    const NumaTopology &topology() const {
+        return topology_;
+    }
+
+    // Make this pool run the pipelines' parallel loops, through
+    // halide_set_custom_do_par_for, or give them back to Halide's pool.
+    // Loops nested in a task run serially in it.
+    void install();
+    void uninstall();
+
+    // Run f(node, begin, end) for every node's range of [0, n), on a
+    // thread of that node, and wait for all of them.
+    void run_on_nodes(int n, const std::function<void(int node, int begin, int end)> &f);
+
+    // The node that ran each task of every outermost parallel loop
+    // since the last clear_history()
+    std::vector<std::vector<int>> history();
+    void clear_history();
+
+private:
+    struct Job;
+
+    // Run body(i) for i in [0, size), node k starting on its own range;
+    // with steal, nodes that finish early help the others. Returns the
+    // first nonzero result of body.
+    int run(int size, bool steal, bool record, const std::function<int(int)> &body);
+    void worker(int node);
+    void run_tasks(Job *job, int node);
+    static int do_par_for(void *user_context, int (*task)(void *, int, uint8_t *), int min, int size, uint8_t *closure);
+
+    NumaTopology topology_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_, run_mutex_;
+    std::condition_variable wake_, done_;
+    Job *job_ = nullptr;
+    unsigned generation_ = 0;
+    bool stop_ = false;
+    std::vector<std::vector<int>> history_;
+};
+
+// Write every row (dimension 1) of buf with init, which gets the crop
+// of buf to a node's rows, on a thread of that node. Rows are split
+// like the strips of a parallel loop over them.
+void first_touch(NumaPool &pool, Halide::Runtime::Buffer<> buf,
+                 const std::function<void(Halide::Runtime::Buffer<> rows)> &init);
+
+// The node whose memory holds the page at p, or -1 if unknown.
+int home_node(const NumaTopology &topology, const void *p);
+
+// home_node of the start of every row (dimension 1) of buf
+std::vector<int> row_home_nodes(const NumaTopology &topology, const Halide::Runtime::Buffer<> &buf);
+
+// For a parallel loop whose task i read the proportional share
+// [i, i + 1) * rows / tasks of the rows, the fraction of those rows on
+// the node that ran the task. task_nodes is one entry of history().
+double node_local_ratio(const std::vector<int> &task_nodes, const std::vector<int> &row_nodes);
+
+}  // namespace HalideSupport
+
+#endif  // HALIDE_SUPPORT_NUMA_H
@@ -0,0 +1,93 @@
+#include "thread_budget.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "HalideRuntime.h"
+
+namespace HalideSupport {
+
+namespace {
+
+thread_local bool in_budgeted_share = false;
+
+// One parallel loop of a budgeted call, split into shares
+struct Loop {
+    int (*task)(void *, int, uint8_t *);
+    uint8_t *closure;
+    int min, size;
+    Cancellation *cancel;
+    std::atomic<int> next{0};
+};
+
+bool should_stop(Cancellation *cancel) {
+    return cancel && cancel->should_stop();
+}
+
+int serial_loop(void *user_context, int (*task)(void *, int, uint8_t *), int min, int size, uint8_t *closure,
+                Cancellation *cancel) {
+    for (int i = 0; i < size; i++) {
+        if (should_stop(cancel)) {
+            return cancelled_error;
+        }
+        if (int result = task(user_context, min + i, closure)) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+// One share: claim iterations of the loop until none are left.
+int run_share(void *user_context, int share, uint8_t *closure) {
+    Loop *loop = (Loop *)closure;
+    const bool was_in_share = in_budgeted_share;
+    in_budgeted_share = true;
+    int result = 0;
+    for (int i = loop->next++; i < loop->size; i = loop->next++) {
+        result = should_stop(loop->cancel) ? cancelled_error : loop->task(user_context, loop->min + i, loop->closure);
+        if (result) {
+            // Stop the other shares too.
+            loop->next = loop->size;
+            break;
+        }
+    }
+    in_budgeted_share = was_in_share;
+    return result;
+}
+
+// One iteration of an unlimited loop that can be cancelled
+int run_checked(void *user_context, int i, uint8_t *closure) {
+    Loop *loop = (Loop *)closure;
+    if (should_stop(loop->cancel)) {
+        return cancelled_error;
+    }
+    return loop->task(user_context, i, loop->closure);
+}
+
+int budgeted_do_par_for(void *user_context, int (*task)(void *, int, uint8_t *), int min, int size, uint8_t *closure) {
+    const ThreadBudget *budget = (const ThreadBudget *)user_context;
+    if (!budget || (budget->threads <= 0 && !budget->cancel)) {
+        return halide_default_do_par_for(user_context, task, min, size, closure);
+    }
+    if (budget->threads == 1 || in_budgeted_share || size <= 1) {
+        return serial_loop(user_context, task, min, size, closure, budget->cancel);
+    }
+    Loop loop;
+    loop.task = task;
+    loop.closure = closure;
+    loop.min = min;
+    loop.size = size;
+    loop.cancel = budget->cancel;
+    if (budget->threads <= 0) {
+        return halide_default_do_par_for(user_context, run_checked, min, size, (uint8_t *)&loop);
+    }
+    return halide_default_do_par_for(user_context, run_share, 0, std::min(budget->threads, size), (uint8_t *)&loop);
+}
+
+}  // namespace
+
+void install_thread_budgets() {
+    halide_set_custom_do_par_for(&budgeted_do_par_for);
+}
+
+}  // namespace HalideSupport
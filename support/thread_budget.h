@@ -0,0 +1,56 @@
+#ifndef HALIDE_SUPPORT_THREAD_BUDGET_H
+#define HALIDE_SUPPORT_THREAD_BUDGET_H
+
+// Per-call limits on parallelism. Halide's thread pool is shared by the
+// whole process, so one large call can occupy every worker while small
+// calls queue behind its tasks. A pipeline generated with the
+// user_context feature takes a pointer as its first argument and hands
+// it to every parallel loop; passing a ThreadBudget there caps how many
+// threads that call's loops may use at once.
+//
+//   HalideSupport::install_thread_budgets();
+//   HalideSupport::ThreadBudget big{4}, small{1};
+//   halide_blur_budget(&big, large_in, large_out);   // at most 4 threads
+//   halide_blur_budget(&small, tiny_in, tiny_out);   // inline, no pool
+//
+// A budget of K splits each loop into K shares, which K pool threads
+// work through by claiming iterations one at a time. Loops nested in a
+// share run serially on its thread. A budget of 1 runs the loops on the
+// calling thread without touching the pool, so a tiny call never waits
+// for a worker. Pipelines without user_context, and calls passing
+// nullptr, are unlimited as before.
+//
+// A ThreadBudget can also carry a Cancellation (see cancellation.h),
+// which is checked before every iteration of the call's loops.
+//
+// This takes over halide_set_custom_do_par_for, so it can't be used
+// together with NumaPool.
+
+#include "cancellation.h"
+
+namespace HalideSupport {
+
+struct ThreadBudget {
+    // Most threads any parallel loop of the call may use; 1 runs them
+    // inline on the calling thread, 0 leaves them unlimited.
+    int threads = 0;
+    // Checked before every iteration, if set
+    Cancellation *cancel = nullptr;
+
+    // Inline for calls producing fewer than inline_below pixels,
+    // otherwise threads.
+    static ThreadBudget for_pixels(double pixels, int threads, double inline_below = 256 * 1024) {
+        ThreadBudget budget;
+        budget.threads = pixels < inline_below ? 1 : threads;
+        return budget;
+    }
+};
+
+// Make the pipelines' parallel loops respect the ThreadBudget passed as
+// their user_context. Every pipeline in the process taking a
+// user_context must then be passed a ThreadBudget or nullptr.
+void install_thread_budgets();
+
+}  // namespace HalideSupport
+
+#endif  // HALIDE_SUPPORT_THREAD_BUDGET_H
@@ -22,8 +22,9 @@
 #include <emmintrin.h>
 #endif
 
-// We'll also need a clock to do performance testing at the end.
-#include "clock.h"
+// We'll also need the shared benchmark harness to do performance
+// testing at the end.
+#include "halide_bench.h"
 
 using namespace Halide;
 
@@ -795,13 +796,9 @@ int main(int argc, char **argv) {
         // Don't include the time required to allocate the output buffer.
         Buffer<uint8_t> c_result(input.width(), input.height());
 
-#ifdef _OPENMP
-        double t1 = current_time();
-#endif
-
-        // Run this one hundred times so we can average the timing results.
-        for (int iters = 0; iters < 100; iters++) {
-
+        // Wrap it in a function so that we can run it once here for
+        // the correctness check, and again to time it.
+        auto c_spread = [&]() {
 #pragma omp parallel for
             for (int yo = 0; yo < (input.height() + 31) / 32; yo++) {
                 int y_base = std::min(yo * 32, input.height() - 32);
@@ -889,20 +886,20 @@ int main(int argc, char **argv) {
 
                 free(clamped_storage);
             }
-        }
+        };
+        c_spread();
 
 // Skip the timing comparison if we don't have openmp
 // enabled. Otherwise it's unfair to C.
 #ifdef _OPENMP
-        double t2 = current_time();
-
-        // Now run the Halide version again without the
-        // jit-compilation overhead. Also run it one hundred times.
-        for (int iters = 0; iters < 100; iters++) {
-            spread.realize(halide_result);
-        }
-
-        double t3 = current_time();
+        // Time both with the shared harness (see bench/halide_bench.h),
+        // which reports the median of 10 samples of 10 runs each. The
+        // Halide version's jit-compilation happened above, so it isn't
+        // included.
+        double c_time = HalideBench::benchmark("lesson_09/spread_c", 10, 10, c_spread).median;
+        double halide_time = HalideBench::benchmark("lesson_09/spread_halide", 10, 10, [&]() {
+                                 spread.realize(halide_result);
+                             }).median;
 
         // Report the timings. On my machine they both take about 3ms
         // for the 4-megapixel input (fast!), which makes sense,
@@ -910,7 +907,7 @@ int main(int argc, char **argv) {
         // parallelization strategy. However I find the Halide easier
         // to read, write, debug, modify, and port.
         printf("Halide spread took %f ms. C equivalent took %f ms\n",
-               (t3 - t2) / 100, (t2 - t1) / 100);
+               halide_time * 1e3, c_time * 1e3);
 
 #endif  // _OPENMP
 
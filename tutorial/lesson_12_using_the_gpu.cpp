@@ -20,8 +20,14 @@
 
 #include "Halide.h"
 
-// Include a clock to do performance testing.
-#include "clock.h"
+// Include the shared benchmark harness to do performance testing.
+#include "halide_bench.h"
+
+// Include the on-disk cache for JIT-compiled pipelines, where there is
+// one.
+#ifdef WITH_JIT_CACHE
+#include "jit_cache.h"
+#endif
 
 // Include some support code for loading pngs.
 #include "halide_image_io.h"
@@ -41,6 +47,10 @@ class MyPipeline {
 public:
     Func lut, padded, padded16, sharpen, curved;
     Buffer<uint8_t> input;
+#ifdef WITH_JIT_CACHE
+    // The compiled pipeline, when it came from the JIT cache
+    HalideSupport::CachedPipeline cached;
+#endif
 
     MyPipeline(Buffer<uint8_t> in)
         : input(in) {
@@ -106,7 +116,7 @@ public:
 
         // JIT-compile the pipeline for the CPU.
         Target target = get_host_target();
-        curved.compile_jit(target);
+        compile(target);
     }
 
     // Now a schedule that uses CUDA or OpenCL.
@@ -188,47 +198,66 @@ public:
         // slowly pretend it's a GPU, and use one thread per output
         // pixel.
         printf("Target: %s\n", target.to_string().c_str());
-        curved.compile_jit(target);
+        compile(target);
 
         return true;
     }
 
-    void test_performance() {
-        // Test the performance of the scheduled MyPipeline.
-
-        Buffer<uint8_t> output(input.width(), input.height(), input.channels());
+    // compile_jit goes through LLVM every time the program starts. If
+    // HL_JIT_CACHE_DIR is set, we instead keep the compiled pipeline in
+    // that directory (see support/jit_cache.h), keyed by a hash of the
+    // lowered pipeline and the target, and later runs just load it.
+    void compile(const Target &target) {
+#ifdef WITH_JIT_CACHE
+        if (getenv("HL_JIT_CACHE_DIR")) {
+            static HalideSupport::JITCache cache;
+            cached = cache.compile(curved, {}, "lesson_12_curved", target);
+            printf("%s\n", cache.last_report().c_str());
+            if (cached.defined()) {
+                return;
+            }
+        }
+#endif
+        curved.compile_jit(target);
+    }
 
-        // Run the filter once to initialize any GPU runtime state.
+    // Run the pipeline into output, however it was compiled.
+    void run(Buffer<uint8_t> output) {
+#ifdef WITH_JIT_CACHE
+        if (cached.defined()) {
+            if (cached({output.raw_buffer()}) != 0) {
+                printf("Cached pipeline failed\n");
+                exit(-1);
+            }
+            return;
+        }
+#endif
         curved.realize(output);
+    }
 
-        // Now take the best of 3 runs for timing.
-        double best_time = 0.0;
-        for (int i = 0; i < 3; i++) {
-
-            double t1 = current_time();
-
-            // Run the filter 100 times.
-            for (int j = 0; j < 100; j++) {
-                curved.realize(output);
-            }
+    void test_performance(const char *name) {
+        // Test the performance of the scheduled MyPipeline.
 
-            // Force any GPU code to finish by copying the buffer back to the CPU.
-            output.copy_to_host();
+        Buffer<uint8_t> output(input.width(), input.height(), input.channels());
 
-            double t2 = current_time();
+        // Run the filter once to initialize any GPU runtime state.
+        run(output);
 
-            double elapsed = (t2 - t1) / 100;
-            if (i == 0 || elapsed < best_time) {
-                best_time = elapsed;
-            }
-        }
+        // Now time 10 batches of 30 runs each with the shared benchmark
+        // harness (see bench/halide_bench.h), and report the median.
+        HalideBench::Stats stats = HalideBench::benchmark(name, 10, 30, [&]() {
+            run(output);
+            // Force any GPU code to finish before the clock stops.
+            output.device_sync();
+        });
 
-        printf("%1.4f milliseconds\n", best_time);
+        printf("%1.4f milliseconds (%s)\n", stats.median * 1000, stats.summary().c_str());
     }
 
     void test_correctness(Buffer<uint8_t> reference_output) {
-        Buffer<uint8_t> output =
-            curved.realize(input.width(), input.height(), input.channels());
+        Buffer<uint8_t> output(input.width(), input.height(), input.channels());
+        run(output);
+        output.copy_to_host();
 
         // Check against the reference output.
         for (int c = 0; c < input.channels(); c++) {
@@ -258,7 +287,7 @@ int main(int argc, char **argv) {
     printf("Running pipeline on CPU:\n");
     MyPipeline p1(input);
     p1.schedule_for_cpu();
-    p1.curved.realize(reference_output);
+    p1.run(reference_output);
 
     printf("Running pipeline on GPU:\n");
     MyPipeline p2(input);
@@ -271,11 +300,11 @@ int main(int argc, char **argv) {
     }
 
     printf("Testing performance on CPU:\n");
-    p1.test_performance();
+    p1.test_performance("lesson_12/cpu");
 
     if (has_gpu_target) {
         printf("Testing performance on GPU:\n");
-        p2.test_performance();
+        p2.test_performance("lesson_12/gpu");
     }
 
     return 0;
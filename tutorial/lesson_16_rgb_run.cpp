@@ -21,7 +21,13 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "halide_benchmark.h"
+// The benchmark harness shared by the examples and tutorials.
+#include "halide_bench.h"
+
+#ifdef WITH_LAYOUT_CONVERSION
+// The layout conversion kernels from examples/convert.
+#include "convert_image.h"
+#endif
 
 void check_timing(double faster, double slower) {
     if (faster > slower) {
@@ -49,34 +55,75 @@ int main(int argc, char **argv) {
     assert(interleaved_input.dim(2).stride() == 1);
     assert(interleaved_output.dim(2).stride() == 1);
 
+    // Put the same pixels in both inputs, so that we time the code on
+    // real data and can check the two layouts give the same answer.
+    planar_input.for_each_element([&](int x, int y, int c) {
+        planar_input(x, y, c) = (uint8_t)(x + 3 * y + 85 * c);
+    });
+
+    constexpr int samples = 10;
+    constexpr int iterations = 100;
+
+#ifdef WITH_LAYOUT_CONVERSION
+    // Converting between the layouts is a pipeline of its own: a
+    // vectorized copy whose loads or stores are interleaved with vector
+    // shuffles. Its cost is what it takes to run, say, an interleaved
+    // pipeline on planar data.
+    Halide::Runtime::Buffer<> interleaved_input_view = interleaved_input;
+    double to_interleaved_time = HalideBench::benchmark("lesson_16/to_interleaved", samples, iterations, [&]() {
+        ImageConvert::convert_layout_into(planar_input, interleaved_input_view);
+    }).median;
+    printf("planar to interleaved: %f msec\n", to_interleaved_time * 1000.f);
+#else
+    interleaved_input.copy_from(planar_input);
+#endif
+
     // We'll now call the various functions we compiled and check the
     // performance of each.
 
-    constexpr int samples = 1;
-    constexpr int iterations = 1000;
-
     // Run the planar version of the code on the planar images and the
     // interleaved version of the code on the interleaved
-    // images. We'll use Halide's benchmarking utility, which takes a function
-    // to run, the number of batches to run (1 in this case), and the number
-    // of iterations per batch (1000 in this case). It returns the best
-    // average-iteration time, in seconds. (See halide_benchmark.h for more
+    // images. We'll use the benchmark harness in bench/, which takes a name
+    // to record the result under, the number of batches to run (10 in this
+    // case), the number of iterations per batch (100 in this case), and a
+    // function to run. It returns statistics of the average-iteration time
+    // per batch, in seconds; we use the median. (See halide_bench.h for more
     // information.)
 
-    double planar_time = Halide::Tools::benchmark(samples, iterations, [&]() {
+    double planar_time = HalideBench::benchmark("lesson_16/planar", samples, iterations, [&]() {
         brighten_planar(planar_input, 1, planar_output);
-    });
+    }).median;
     printf("brighten_planar: %f msec\n", planar_time * 1000.f);
 
-    double interleaved_time = Halide::Tools::benchmark(samples, iterations, [&]() {
+    double interleaved_time = HalideBench::benchmark("lesson_16/interleaved", samples, iterations, [&]() {
         brighten_interleaved(interleaved_input, 1, interleaved_output);
-    });
+    }).median;
     printf("brighten_interleaved: %f msec\n", interleaved_time * 1000.f);
 
     // Planar is generally faster than interleaved for most imaging
     // operations.
     check_timing(planar_time, interleaved_time);
 
+    // Both versions computed the same image.
+    Halide::Runtime::Buffer<uint8_t> interleaved_as_planar(1024, 768, 3);
+#ifdef WITH_LAYOUT_CONVERSION
+    Halide::Runtime::Buffer<> interleaved_as_planar_view = interleaved_as_planar;
+    double to_planar_time = HalideBench::benchmark("lesson_16/to_planar", samples, iterations, [&]() {
+        ImageConvert::convert_layout_into(interleaved_output, interleaved_as_planar_view);
+    }).median;
+    printf("interleaved to planar: %f msec\n", to_planar_time * 1000.f);
+#else
+    interleaved_as_planar.copy_from(interleaved_output);
+#endif
+    bool same = true;
+    planar_output.for_each_element([&](int x, int y, int c) {
+        same = same && planar_output(x, y, c) == interleaved_as_planar(x, y, c);
+    });
+    if (!same) {
+        fprintf(stderr, "brighten_planar and brighten_interleaved disagree\n");
+        return 1;
+    }
+
     // Either of these next two commented-out calls would throw an
     // error, because the stride is not what we promised it would be
     // in the generator.
@@ -89,15 +136,15 @@ int main(int argc, char **argv) {
 
     // Run the flexible version of the code and check performance. It
     // should work, but it'll be slower than the versions above.
-    double either_planar_time = Halide::Tools::benchmark(samples, iterations, [&]() {
+    double either_planar_time = HalideBench::benchmark("lesson_16/either_planar", samples, iterations, [&]() {
         brighten_either(planar_input, 1, planar_output);
-    });
+    }).median;
     printf("brighten_either on planar images: %f msec\n", either_planar_time * 1000.f);
     check_timing(planar_time, either_planar_time);
 
-    double either_interleaved_time = Halide::Tools::benchmark(samples, iterations, [&]() {
+    double either_interleaved_time = HalideBench::benchmark("lesson_16/either_interleaved", samples, iterations, [&]() {
         brighten_either(interleaved_input, 1, interleaved_output);
-    });
+    }).median;
     printf("brighten_either on interleaved images: %f msec\n", either_interleaved_time * 1000.f);
     check_timing(interleaved_time, either_interleaved_time);
 
@@ -105,9 +152,9 @@ int main(int argc, char **argv) {
     // should match the performance of the code compiled specifically
     // for each case above by branching internally to equivalent
     // code.
-    double specialized_planar_time = Halide::Tools::benchmark(samples, iterations, [&]() {
+    double specialized_planar_time = HalideBench::benchmark("lesson_16/specialized_planar", samples, iterations, [&]() {
         brighten_specialized(planar_input, 1, planar_output);
-    });
+    }).median;
     printf("brighten_specialized on planar images: %f msec\n", specialized_planar_time * 1000.f);
 
     // The cost of the if statement should be negligible, but we'll
@@ -115,9 +162,9 @@ int main(int argc, char **argv) {
     // measurement noise.
     check_timing(specialized_planar_time, 1.5 * planar_time);
 
-    double specialized_interleaved_time = Halide::Tools::benchmark(samples, iterations, [&]() {
+    double specialized_interleaved_time = HalideBench::benchmark("lesson_16/specialized_interleaved", samples, iterations, [&]() {
         brighten_specialized(interleaved_input, 1, interleaved_output);
-    });
+    }).median;
     printf("brighten_specialized on interleaved images: %f msec\n", specialized_interleaved_time * 1000.f);
     check_timing(specialized_interleaved_time, 2.0 * interleaved_time);
 
@@ -13,7 +13,7 @@
 // We'll use the Halide::Runtime::Buffer class for passing data into and out of
 // the pipeline.
 #include "HalideBuffer.h"
-#include "halide_benchmark.h"
+#include "halide_bench.h"
 
 #include <assert.h>
 #include <stdio.h>
@@ -36,14 +36,14 @@ int main(int argc, char **argv) {
     Halide::Runtime::Buffer<float> output2(1024, 1024);
     // Run each version of the codes (with no auto-schedule and with
     // auto-schedule) multiple times for benchmarking.
-    double auto_schedule_off = Halide::Tools::benchmark(2, 5, [&]() {
+    double auto_schedule_off = HalideBench::benchmark("lesson_21/manual", 10, 5, [&]() {
         auto_schedule_false(input, 2.0f, output1, output2);
-    });
+    }).median;
     printf("Manual schedule: %gms\n", auto_schedule_off * 1e3);
 
-    double auto_schedule_on = Halide::Tools::benchmark(2, 5, [&]() {
+    double auto_schedule_on = HalideBench::benchmark("lesson_21/auto", 10, 5, [&]() {
         auto_schedule_true(input, 2.0f, output1, output2);
-    });
+    }).median;
     printf("Auto schedule: %gms\n", auto_schedule_on * 1e3);
 
     // auto_schedule_on should be faster since in the auto_schedule_off version,